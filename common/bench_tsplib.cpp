@@ -0,0 +1,62 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include "tsplib.hpp"
+#include "../concurrent/matrix.hpp"
+
+using namespace std;
+
+// Writes a random EUC_2D instance of NODES nodes, then times the three
+// loading stages: parsing, distance table, neighbour lists.
+#define NODES 10000
+
+static double seconds_since(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+    int nodes = argc > 1 ? atoi(argv[1]) : NODES;
+    string fname = argc > 2 ? argv[2] : "/tmp/bench_tsplib.tsp";
+
+    FILE *f = fopen(fname.c_str(), "w");
+    if (!f)
+    {
+        perror(fname.c_str());
+        return 1;
+    }
+    mt19937 random(42);
+    uniform_real_distribution<double> coordinate(0, 100000);
+    fprintf(f, "NAME: bench%d\nTYPE: TSP\nDIMENSION: %d\nEDGE_WEIGHT_TYPE: EUC_2D\nNODE_COORD_SECTION\n", nodes, nodes);
+    for (int i = 1; i <= nodes; ++i)
+    {
+        fprintf(f, "%d %.4f %.4f\n", i, coordinate(random), coordinate(random));
+    }
+    fprintf(f, "EOF\n");
+    long bytes = ftell(f);
+    fclose(f);
+
+    auto start = chrono::steady_clock::now();
+    TSPLib::Instance instance = TSPLib::load(fname);
+    double parse = seconds_since(start);
+
+    start = chrono::steady_clock::now();
+    Matrix matrix(nodes, TSPLib::max_distance(instance));
+    TSPLib::fill(instance, [&](int i, int j, int d) { matrix.set_distance(i, j, d); });
+    double table = seconds_since(start);
+
+    start = chrono::steady_clock::now();
+    matrix.update_neighbours();
+    double neighbours = seconds_since(start);
+
+    cout << "nodes;bytes;threads;parse s;parse MB/s;table s;neighbours s" << endl;
+    cout << nodes << ";" << bytes << ";" << thread::hardware_concurrency() << ";"
+         << parse << ";" << bytes / parse / 1e6 << ";" << table << ";" << neighbours << endl;
+
+    remove(fname.c_str());
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#ifndef DISTANCES_HPP
+#define DISTANCES_HPP
+
+/**
+ * Square table of distances in one contiguous, cache-line aligned block.
+ *
+ * Every row starts on a cache line: the rows are padded to a multiple of
+ * 32 entries, and the padding is zero. The entries are 16-bit as long as
+ * every distance fits, which halves the cache lines a row takes, and are
+ * widened once to 32-bit when a larger distance is set.
+ *
+ * Code reading whole rows (bound and cost kernels) checks narrow() once and
+ * then works on row16() or row32(); distance() hides the choice for
+ * single lookups.
+*/
+class Distances {
+public:
+    static const int ALIGN = 64;    // bytes
+    static const int LANES = 32;    // row padding, in entries
+
+    /**
+     * @param maxDistance An upper bound of the distances, if known: the entries
+     *                    start 32-bit right away if it does not fit in 16 bits.
+    */
+    explicit Distances(int order, int maxDistance = 0)
+        : _order(order), _stride((order + LANES - 1) / LANES * LANES), _narrow(maxDistance <= INT16_MAX)
+    {
+        _data = allocate(_narrow ? sizeof(int16_t) : sizeof(int32_t));
+    }
+
+    /**
+     * View a table laid out by another Distances, such as a mapped InstanceCache.
+     * The data is not copied nor freed, and the table is read-only: set() must not be called.
+    */
+    Distances(int order, int stride, bool narrow, const void *data)
+        : _order(order), _stride(stride), _narrow(narrow), _data(const_cast<void *>(data)), _owned(false)
+    {
+    }
+
+    ~Distances()
+    {
+        if (_owned) {
+            std::free(_data);
+        }
+    }
+
+    Distances(const Distances &) = delete;
+    Distances &operator=(const Distances &) = delete;
+
+    int order() const { return _order; }
+
+    /**
+     * Get the number of entries between the starts of two rows.
+    */
+    int stride() const { return _stride; }
+
+    /**
+     * Tell if the entries are stored as 16-bit integers.
+    */
+    bool narrow() const { return _narrow; }
+
+    int distance(int i, int j) const
+    {
+        return _narrow ? row16(i)[j] : row32(i)[j];
+    }
+
+    /**
+     * Set the distance from i to j (only that direction).
+     * The table is widened to 32-bit entries if the distance does not fit in 16 bits;
+     * distinct entries can only be set concurrently if that cannot happen.
+    */
+    void set(int i, int j, int distance)
+    {
+        if (_narrow && (distance > INT16_MAX || distance < INT16_MIN)) {
+            widen();
+        }
+        if (_narrow) {
+            static_cast<int16_t *>(_data)[(size_t) i * _stride + j] = distance;
+        } else {
+            static_cast<int32_t *>(_data)[(size_t) i * _stride + j] = distance;
+        }
+    }
+
+    const int16_t *row16(int i) const { return static_cast<const int16_t *>(_data) + (size_t) i * _stride; }
+    const int32_t *row32(int i) const { return static_cast<const int32_t *>(_data) + (size_t) i * _stride; }
+
+private:
+    void *allocate(size_t entry)
+    {
+        size_t size = (size_t) _order * _stride * entry;
+        size = (size + ALIGN - 1) / ALIGN * ALIGN;
+        void *data = std::aligned_alloc(ALIGN, size ? size : ALIGN);
+        if (!data) {
+            throw std::bad_alloc();
+        }
+        std::memset(data, 0, size);
+        return data;
+    }
+
+    void widen()
+    {
+        int32_t *data = static_cast<int32_t *>(allocate(sizeof(int32_t)));
+        for (int i = 0; i < _order; i++) {
+            for (int j = 0; j < _order; j++) {
+                data[(size_t) i * _stride + j] = row16(i)[j];
+            }
+        }
+        std::free(_data);
+        _data = data;
+        _narrow = false;
+    }
+
+    int _order;
+    int _stride;
+    bool _narrow;
+    void *_data;
+    bool _owned = true;
+};
+
+#endif // DISTANCES_HPP
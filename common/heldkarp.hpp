@@ -0,0 +1,498 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "heuristic.hpp"
+
+#ifndef HELDKARP_HPP
+#define HELDKARP_HPP
+
+/**
+ * Exact solver by dynamic programming over subsets (Held-Karp), in
+ * O(n^2 2^n) time and O(n 2^n) memory, whatever the distances.
+ *
+ * Tours start at node 0. The table holds, for every subset S of the other
+ * nodes and every node j of S, the cost of the shortest path leaving node 0,
+ * visiting S and ending at j. It is subset-major: the n - 1 entries of a
+ * subset are contiguous, so computing an entry reads one row of the
+ * table and one row of the distances.
+ *
+ * The subsets are computed by layers of equal size, each layer only
+ * reading the previous one. The subsets of a layer are enumerated by rank
+ * and split into equal shares among the threads.
+ *
+ * Costs are capped at upper + 1, upper being the cost of any known tour:
+ * a path longer than upper cannot be part of a shorter tour, and the cap
+ * keeps the sums from overflowing. When upper fits, the entries are 16-bit,
+ * which halves the memory.
+ *
+ * When the whole table does not fit, meet_in_the_middle() only keeps the
+ * subsets of about half the nodes: a tour is a path from node 0 to a middle
+ * node c through one half of the nodes, and a path back from c through the
+ * other half. Both halves come from the same layers of paths leaving node
+ * 0 (the second half read backwards), computed two layers at a time, each
+ * subset stored at its combinatorial rank with one entry per node it holds.
+*/
+class HeldKarp {
+public:
+    /**
+     * Get the size of the table for order nodes.
+    */
+    static size_t table_bytes(int order, int upper)
+    {
+        int m = std::max(order - 1, 1);
+        if (m >= 48) {
+            return SIZE_MAX;
+        }
+        size_t subsets = (size_t) 1 << m;
+        size_t entry = narrow(upper) ? sizeof(uint16_t) : sizeof(int32_t);
+        return subsets > SIZE_MAX / m / entry ? SIZE_MAX : subsets * m * entry;
+    }
+
+    /**
+     * Get the number of entries computed for order nodes times the cost of
+     * each one, a measure of the running time.
+    */
+    static double work(int order)
+    {
+        int m = std::max(order - 1, 1);
+        return (double) m * m * std::ldexp(1.0, m);
+    }
+
+    /**
+     * Get the memory available to the process, in bytes.
+    */
+    static size_t available_memory()
+    {
+        long pages = sysconf(_SC_AVPHYS_PAGES);
+        long size = sysconf(_SC_PAGE_SIZE);
+        return pages > 0 && size > 0 ? (size_t) pages * size : 0;
+    }
+
+    /**
+     * Find a shortest tour.
+     * @param upper Cost of a known tour, bounding the costs stored.
+     * @return the tour, starting at node 0, or an empty tour if the table cannot be allocated.
+    */
+    template <typename Distance>
+    static std::vector<int> solve(int order, Distance d, int upper, int nThreads)
+    {
+        if (order <= 2) {
+            std::vector<int> tour;
+            for (int i = 0; i < order; i++) {
+                tour.push_back(i);
+            }
+            return tour;
+        }
+        if (order == 3) {
+            // Only two tours, which differ when the distances are asymmetric
+            std::vector<int> tour = { 0, 1, 2 };
+            std::vector<int> back = { 0, 2, 1 };
+            return Heuristic::cost(back, d) < Heuristic::cost(tour, d) ? back : tour;
+        }
+        if (narrow(upper)) {
+            return solve<uint16_t>(order, d, upper, nThreads);
+        }
+        return solve<int32_t>(order, d, upper, nThreads);
+    }
+
+    /**
+     * Get the peak memory of meet_in_the_middle() for order nodes.
+    */
+    static size_t halves_bytes(int order, int upper, bool symmetric)
+    {
+        int m = std::max(order - 1, 1);
+        if (m >= 63) {
+            return SIZE_MAX;
+        }
+        int a = (m + 2) / 2;
+        int b = m + 1 - a;
+        size_t entry = narrow(upper) ? sizeof(uint16_t) : sizeof(int32_t);
+        double peak = 0;
+        for (int k = 1; k <= a; k++) {
+            peak = std::max(peak, layer_entries(m, k - 1) + layer_entries(m, k));
+        }
+        if (!symmetric) {
+            // the first half is kept while the layers of the second are computed
+            for (int k = 1; k <= b; k++) {
+                peak = std::max(peak, layer_entries(m, a) + layer_entries(m, k - 1) + layer_entries(m, k));
+            }
+        }
+        return peak * entry >= (double) SIZE_MAX ? SIZE_MAX : (size_t) (peak * entry);
+    }
+
+    /**
+     * Find a shortest tour joining two half tours, see above.
+     * @param upper Cost of a known tour, bounding the costs stored.
+     * @return the tour, starting at node 0, or an empty tour if the layers cannot be allocated.
+    */
+    template <typename Distance>
+    static std::vector<int> meet_in_the_middle(int order, Distance d, int upper, int nThreads)
+    {
+        if (order <= 3) {
+            return solve(order, d, upper, nThreads);
+        }
+        try {
+            if (narrow(upper)) {
+                return halves<uint16_t>(order, d, upper, nThreads);
+            }
+            return halves<int32_t>(order, d, upper, nThreads);
+        } catch (const std::bad_alloc &) {
+            return std::vector<int>();
+        }
+    }
+
+private:
+    static bool narrow(int upper) { return upper < UINT16_MAX; }
+
+    // Subsets of size k of m nodes times their k entries
+    static double layer_entries(int m, int k)
+    {
+        double subsets = 1;
+        for (int i = 1; i <= k; i++) {
+            subsets = subsets * (m - k + i) / i;
+        }
+        return subsets * k;
+    }
+
+    // Binomial coefficients C(n, k) for n < 64, to rank the subsets
+    struct Binomials {
+        uint64_t c[64][64];
+
+        Binomials()
+        {
+            for (int n = 0; n < 64; n++) {
+                c[n][0] = 1;
+                for (int k = 1; k < 64; k++) {
+                    c[n][k] = n ? c[n - 1][k - 1] + c[n - 1][k] : 0;
+                }
+            }
+        }
+
+        // Rank of a subset among the subsets of its size, in increasing order
+        uint64_t rank(uint64_t s) const
+        {
+            uint64_t r = 0;
+            for (int k = 1; s; s &= s - 1, k++) {
+                r += c[__builtin_ctzll(s)][k];
+            }
+            return r;
+        }
+
+        uint64_t unrank(uint64_t r, int k) const
+        {
+            uint64_t s = 0;
+            for (int p = 63; k > 0; p--) {
+                if (c[p][k] <= r) {
+                    r -= c[p][k];
+                    s |= (uint64_t) 1 << p;
+                    k--;
+                }
+            }
+            return s;
+        }
+    };
+
+    // Paths leaving node 0 through every subset of size k of the m other nodes,
+    // entry i of a subset being the path ending at its i-th node
+    template <typename T>
+    struct Layer {
+        int size = 0;
+        std::vector<T> entries;
+    };
+
+    // Next subset of the same size, in increasing order
+    static uint64_t next_subset(uint64_t s)
+    {
+        uint64_t low = s & -s;
+        uint64_t ripple = s + low;
+        return (((ripple ^ s) >> 2) / low) | ripple;
+    }
+
+    // Call f(t, s, rank) on the subsets of size k of m nodes, split among the threads t
+    template <typename F>
+    static void parallel_subsets(const Binomials &binomials, int m, int k, int nThreads, F f)
+    {
+        parallel(binomials.c[m][k], nThreads, [&](int t, size_t begin, size_t end) {
+            if (begin >= end) {
+                return;
+            }
+            uint64_t s = binomials.unrank(begin, k);
+            for (size_t r = begin; r < end; r++, s = next_subset(s)) {
+                f(t, s, r);
+            }
+        });
+    }
+
+    // Compute the layers up to size last, keeping the last one and, if asked, the one before
+    template <typename T, typename Distance>
+    static Layer<T> layers(const Binomials &binomials, int m, Distance d, long cap, int last, int nThreads, Layer<T> *before)
+    {
+        std::vector<int> to((size_t) m * m);
+        for (int i = 0; i < m; i++) {
+            for (int j = 0; j < m; j++) {
+                to[(size_t) j * m + i] = d(i + 1, j + 1);
+            }
+        }
+
+        Layer<T> previous;
+        Layer<T> current;
+        current.size = 1;
+        current.entries.resize(m);
+        for (int j = 0; j < m; j++) {
+            current.entries[j] = (T) std::min((long) d(0, j + 1), cap);
+        }
+
+        for (int k = 2; k <= last; k++) {
+            previous = std::move(current);
+            current = Layer<T>();
+            current.size = k;
+            current.entries.resize(binomials.c[m][k] * k);
+            parallel_subsets(binomials, m, k, nThreads, [&](int, uint64_t s, size_t rank) {
+                // rank of s without its t-th node: the nodes after it move down one place
+                int nodes[64];
+                uint64_t below[65];
+                uint64_t above[65];
+                int n = 0;
+                for (uint64_t r = s; r; r &= r - 1) {
+                    nodes[n++] = __builtin_ctzll(r);
+                }
+                below[0] = 0;
+                for (int t = 0; t < n; t++) {
+                    below[t + 1] = below[t] + binomials.c[nodes[t]][t + 1];
+                }
+                above[n] = 0;
+                for (int t = n - 1; t >= 0; t--) {
+                    above[t] = above[t + 1] + binomials.c[nodes[t]][t];
+                }
+
+                T *row = current.entries.data() + rank * k;
+                for (int t = 0; t < n; t++) {
+                    int j = nodes[t];
+                    const T *from = previous.entries.data() + (below[t] + above[t + 1]) * (k - 1);
+                    const int *distances = to.data() + (size_t) j * m;
+                    long best = cap;
+                    for (int u = 0, v = 0; u < n; u++) {
+                        if (u != t) {
+                            best = std::min(best, (long) from[v++] + distances[nodes[u]]);
+                        }
+                    }
+                    row[t] = (T) best;
+                }
+            });
+        }
+        if (before) {
+            *before = std::move(previous);
+        }
+        return current;
+    }
+
+    template <typename T, typename Distance>
+    static std::vector<int> halves(int order, Distance d, int upper, int nThreads)
+    {
+        static const Binomials binomials;
+        int m = order - 1;
+        int a = (m + 2) / 2;    // nodes of the first half, the middle node included
+        int b = m + 1 - a;      // nodes of the second half, the middle node included
+        long cap = (long) upper + 1;
+        auto back = [&d](int i, int j) { return d(j, i); };
+
+        Layer<T> first;
+        Layer<T> second;
+        if (Heuristic::symmetric(order, d)) {
+            first = layers<T>(binomials, m, d, cap, a, nThreads, b < a ? &second : nullptr);
+        } else {
+            first = layers<T>(binomials, m, d, cap, a, nThreads, nullptr);
+            second = layers<T>(binomials, m, back, cap, b, nThreads, nullptr);
+        }
+        const Layer<T> &last = second.size ? second : first;
+
+        // Join every first half with the second half through the other nodes
+        uint64_t all = ((uint64_t) 1 << m) - 1;
+        std::vector<long> costs(nThreads, LONG_MAX);
+        std::vector<uint64_t> sets(nThreads);
+        std::vector<int> middles(nThreads);
+        parallel_subsets(binomials, m, a, nThreads, [&](int slice, uint64_t s, size_t rank) {
+            const T *row = first.entries.data() + rank * a;
+            int t = 0;
+            for (uint64_t r = s; r; r &= r - 1, t++) {
+                int c = __builtin_ctzll(r);
+                uint64_t other = (all ^ s) | ((uint64_t) 1 << c);
+                int u = __builtin_popcountll(other & (((uint64_t) 1 << c) - 1));
+                long cost = (long) row[t] + last.entries[binomials.rank(other) * b + u];
+                if (cost < costs[slice]) {
+                    costs[slice] = cost;
+                    sets[slice] = s;
+                    middles[slice] = c;
+                }
+            }
+        });
+        int best = std::min_element(costs.begin(), costs.end()) - costs.begin();
+        uint64_t s = sets[best];
+        int c = middles[best];
+        first = Layer<T>();
+        second = Layer<T>();
+
+        // Each half is a small problem of its own
+        std::vector<int> tour = path(d, s, c);
+        std::vector<int> other = path(back, (all ^ s) | ((uint64_t) 1 << c), c);
+        tour.insert(tour.end(), other.rbegin() + 1, other.rend() - 1);
+        return tour;
+    }
+
+    // Shortest path from node 0 through the nodes of s (node i + 1 for bit i), ending at node c + 1
+    template <typename Distance>
+    static std::vector<int> path(Distance d, uint64_t s, int c)
+    {
+        std::vector<int> nodes;
+        int end = 0;
+        for (uint64_t r = s; r; r &= r - 1) {
+            if (__builtin_ctzll(r) == c) {
+                end = nodes.size();
+            }
+            nodes.push_back(__builtin_ctzll(r) + 1);
+        }
+        int k = nodes.size();
+        size_t full = ((size_t) 1 << k) - 1;
+        std::vector<long> table(((size_t) 1 << k) * k, LONG_MAX);
+        for (int j = 0; j < k; j++) {
+            table[((size_t) 1 << j) * k + j] = d(0, nodes[j]);
+        }
+        for (size_t t = 1; t <= full; t++) {
+            for (int j = 0; j < k; j++) {
+                size_t prev = t ^ ((size_t) 1 << j);
+                if (!(t >> j & 1) || !prev) {
+                    continue;
+                }
+                long best = LONG_MAX;
+                for (size_t r = prev; r; r &= r - 1) {
+                    int i = __builtin_ctzll(r);
+                    best = std::min(best, table[prev * k + i] + d(nodes[i], nodes[j]));
+                }
+                table[t * k + j] = best;
+            }
+        }
+
+        std::vector<int> result(k + 1);
+        result[0] = 0;
+        size_t t = full;
+        int j = end;
+        for (int p = k; p >= 1; p--) {
+            result[p] = nodes[j];
+            size_t prev = t ^ ((size_t) 1 << j);
+            for (size_t r = prev; r; r &= r - 1) {
+                int i = __builtin_ctzll(r);
+                if (table[prev * k + i] + d(nodes[i], nodes[j]) == table[t * k + j]) {
+                    j = i;
+                    break;
+                }
+            }
+            t = prev;
+        }
+        return result;
+    }
+
+    template <typename T, typename Distance>
+    static std::vector<int> solve(int order, Distance d, int upper, int nThreads)
+    {
+        int m = order - 1;      // node i + 1 is bit i of the subsets
+        size_t subsets = (size_t) 1 << m;
+        long cap = (long) upper + 1;
+
+        size_t bytes = table_bytes(order, upper);
+        T *table = bytes < SIZE_MAX ? static_cast<T *>(std::malloc(bytes)) : nullptr;
+        if (!table) {
+            return std::vector<int>();
+        }
+
+        // to[j * m + i]: distance from node i + 1 to node j + 1
+        std::vector<int> to((size_t) m * m);
+        for (int i = 0; i < m; i++) {
+            for (int j = 0; j < m; j++) {
+                to[(size_t) j * m + i] = d(i + 1, j + 1);
+            }
+        }
+
+        for (int j = 0; j < m; j++) {
+            table[((size_t) 1 << j) * m + j] = (T) std::min((long) d(0, j + 1), cap);
+        }
+
+        // Each thread gets the same number of subsets of the layer, visited in increasing order
+        static const Binomials binomials;
+        for (int size = 2; size <= m; size++) {
+            parallel_subsets(binomials, m, size, nThreads, [&](int, uint64_t s, size_t) {
+                T *row = table + s * m;
+                for (uint64_t rest = s; rest; rest &= rest - 1) {
+                    int j = __builtin_ctzll(rest);
+                    size_t prev = s ^ ((size_t) 1 << j);
+                    const T *from = table + prev * m;
+                    const int *distances = to.data() + (size_t) j * m;
+                    long best = cap;
+                    for (size_t r = prev; r; r &= r - 1) {
+                        int i = __builtin_ctzll(r);
+                        best = std::min(best, (long) from[i] + distances[i]);
+                    }
+                    row[j] = (T) best;
+                }
+            });
+        }
+
+        // Close the tour at the best last node, then walk back the table
+        size_t all = subsets - 1;
+        long best = LONG_MAX;
+        int last = 0;
+        for (int j = 0; j < m; j++) {
+            long cost = (long) table[all * m + j] + d(j + 1, 0);
+            if (cost < best) {
+                best = cost;
+                last = j;
+            }
+        }
+
+        std::vector<int> tour(order);
+        tour[0] = 0;
+        size_t s = all;
+        for (int k = m; k >= 1; k--) {
+            tour[k] = last + 1;
+            size_t prev = s ^ ((size_t) 1 << last);
+            if (!prev) {
+                break;
+            }
+            long cost = table[s * m + last];
+            for (size_t r = prev; r; r &= r - 1) {
+                int i = __builtin_ctzll(r);
+                if ((long) table[prev * m + i] + to[(size_t) last * m + i] == cost) {
+                    last = i;
+                    break;
+                }
+            }
+            s = prev;
+        }
+
+        std::free(table);
+        return tour;
+    }
+
+    // Call f(t, begin, end) on nThreads contiguous slices of [0, n), in as many threads
+    template <typename F>
+    static void parallel(size_t n, int nThreads, F f)
+    {
+        size_t slice = (n + nThreads - 1) / nThreads;
+        std::vector<std::thread> threads;
+        for (int t = 1; t < nThreads; t++) {
+            size_t begin = std::min(n, t * slice);
+            threads.emplace_back(f, t, begin, std::min(n, begin + slice));
+        }
+        f(0, 0, std::min(n, slice));
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+    }
+};
+
+#endif // HELDKARP_HPP
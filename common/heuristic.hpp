@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifndef HEURISTIC_HPP
+#define HEURISTIC_HPP
+
+/**
+ * Fast tour heuristics, used to start the branch and bound with a good
+ * incumbent instead of the identity tour.
+ *
+ * A tour is the list of its nodes, starting at node 0, the edge back to
+ * node 0 being implicit. Every function takes the distances as a functor
+ * d(i, j), so the same code serves the Graph of tspcc and the Matrix of tspmt.
+*/
+class Heuristic {
+public:
+    /**
+     * Build a tour by always going to the nearest unvisited node, starting at node 0.
+    */
+    template <typename Distance>
+    static std::vector<int> nearest_neighbour(int order, Distance d)
+    {
+        std::vector<int> tour;
+        std::vector<bool> visited(order, false);
+        tour.reserve(order);
+        tour.push_back(0);
+        visited[0] = true;
+
+        for (int k = 1; k < order; k++) {
+            int last = tour.back();
+            int next = -1;
+            for (int j = 0; j < order; j++) {
+                if (!visited[j] && (next < 0 || d(last, j) < d(last, next))) {
+                    next = j;
+                }
+            }
+            tour.push_back(next);
+            visited[next] = true;
+        }
+        return tour;
+    }
+
+    /**
+     * Improve the tour by reversing segments (2-opt) until no reversal shortens it.
+     * @return true if the tour was changed.
+    */
+    template <typename Distance>
+    static bool two_opt(std::vector<int> &tour, Distance d)
+    {
+        int n = tour.size();
+        bool changed = false;
+        bool improved = n >= 4;
+
+        while (improved) {
+            improved = false;
+            for (int i = 0; i < n - 2; i++) {
+                int a = tour[i];
+                int b = tour[i + 1];
+                for (int j = i + 2; j < n; j++) {
+                    int c = tour[j];
+                    int e = tour[(j + 1) % n];
+                    if (e == a) {
+                        continue;
+                    }
+                    if (d(a, c) + d(b, e) < d(a, b) + d(c, e)) {
+                        std::reverse(tour.begin() + i + 1, tour.begin() + j + 1);
+                        b = tour[i + 1];
+                        improved = changed = true;
+                    }
+                }
+            }
+        }
+        return changed;
+    }
+
+    /**
+     * Improve the tour by moving segments of one to three nodes elsewhere,
+     * possibly reversed (Or-opt), until no move shortens it.
+     * @return true if the tour was changed.
+    */
+    template <typename Distance>
+    static bool or_opt(std::vector<int> &tour, Distance d)
+    {
+        int n = tour.size();
+        bool changed = false;
+        bool improved = n >= 5;
+
+        while (improved) {
+            improved = false;
+            for (int length = 1; length <= 3; length++) {
+                for (int i = 0; i + length <= n; i++) {
+                    int first = tour[i];
+                    int last = tour[i + length - 1];
+                    int prev = tour[(i + n - 1) % n];
+                    int next = tour[(i + length) % n];
+                    int gain = d(prev, first) + d(last, next) - d(prev, next);
+
+                    // Try every edge (p, q) from next to prev, outside the segment
+                    for (int k = (i + length) % n; k != (i + n - 1) % n; k = (k + 1) % n) {
+                        int p = tour[k];
+                        int q = tour[(k + 1) % n];
+                        int forward = d(p, first) + d(last, q) - d(p, q);
+                        int backward = d(p, last) + d(first, q) - d(p, q);
+                        if (std::min(forward, backward) < gain) {
+                            move(tour, i, length, p, backward < forward);
+                            improved = changed = true;
+                            break;
+                        }
+                    }
+                    if (improved) {
+                        break;
+                    }
+                }
+            }
+        }
+        return changed;
+    }
+
+    /**
+     * Run 2-opt and Or-opt in turn until neither improves the tour.
+     * The moves reverse parts of the tour, so the distances must be symmetric.
+    */
+    template <typename Distance>
+    static void improve(std::vector<int> &tour, Distance d)
+    {
+        two_opt(tour, d);
+        while (or_opt(tour, d) && two_opt(tour, d)) {
+        }
+    }
+
+    /**
+     * Nearest neighbour tour, improved by local search if the distances are symmetric.
+    */
+    template <typename Distance>
+    static std::vector<int> tour(int order, Distance d)
+    {
+        std::vector<int> tour = nearest_neighbour(order, d);
+        if (symmetric(order, d)) {
+            improve(tour, d);
+        }
+        return tour;
+    }
+
+    /**
+     * Tell if the distances are the same both ways.
+    */
+    template <typename Distance>
+    static bool symmetric(int order, Distance d)
+    {
+        for (int i = 0; i < order; i++) {
+            for (int j = 0; j < i; j++) {
+                if (d(i, j) != d(j, i)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    template <typename Distance>
+    static int cost(const std::vector<int> &tour, Distance d)
+    {
+        int n = tour.size();
+        int cost = 0;
+        for (int i = 0; i < n; i++) {
+            cost += d(tour[i], tour[(i + 1) % n]);
+        }
+        return cost;
+    }
+
+    /**
+     * Read a tour in the TSPLIB format: the node numbers, from 1, follow
+     * the TOUR_SECTION line and end with -1 or at the end of the file.
+     * The program stops with a message if the file is not a tour of order nodes.
+     * @return the tour, rotated to start at node 0.
+    */
+    static std::vector<int> read_tour(const std::string &fname, int order)
+    {
+        FILE *f = fopen(fname.c_str(), "r");
+        if (!f) {
+            abort(fname, std::strerror(errno));
+        }
+
+        char line[1000];
+        bool found = false;
+        while (!found && fgets(line, sizeof(line), f)) {
+            found = !strncmp("TOUR_SECTION", line, 12);
+        }
+        if (!found) {
+            abort(fname, "missing TOUR_SECTION");
+        }
+
+        std::vector<int> tour;
+        std::vector<bool> seen(order, false);
+        int node;
+        while (fscanf(f, "%d", &node) == 1 && node != -1) {
+            if (node < 1 || node > order || seen[node - 1]) {
+                abort(fname, "wrong node " + std::to_string(node));
+            }
+            seen[node - 1] = true;
+            tour.push_back(node - 1);
+        }
+        fclose(f);
+
+        if ((int) tour.size() != order) {
+            abort(fname, "the tour does not visit every node");
+        }
+        std::rotate(tour.begin(), std::find(tour.begin(), tour.end(), 0), tour.end());
+        return tour;
+    }
+
+private:
+    static void abort(const std::string &fname, const std::string &message)
+    {
+        std::cerr << fname << ": " << message << std::endl;
+        exit(1);
+    }
+
+    // Move the segment of length nodes at position i after node p, reversed or not
+    static void move(std::vector<int> &tour, int i, int length, int p, bool reversed)
+    {
+        std::vector<int> segment;
+        for (int k = 0; k < length; k++) {
+            segment.push_back(tour[(i + k) % tour.size()]);
+        }
+        if (reversed) {
+            std::reverse(segment.begin(), segment.end());
+        }
+        tour.erase(tour.begin() + i, tour.begin() + i + length);
+        auto at = std::find(tour.begin(), tour.end(), p) + 1;
+        tour.insert(at, segment.begin(), segment.end());
+        std::rotate(tour.begin(), std::find(tour.begin(), tour.end(), 0), tour.end());
+    }
+};
+
+#endif // HEURISTIC_HPP
@@ -0,0 +1,184 @@
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "distances.hpp"
+
+#ifndef INSTANCE_CACHE_HPP
+#define INSTANCE_CACHE_HPP
+
+/**
+ * Binary file of a precomputed instance: the distance table and the sorted
+ * neighbour lists, exactly as they are laid out in memory.
+ *
+ * Layout, in native byte order:
+ * - a header of 64 bytes (see Header),
+ * - the Distances table, order rows of stride entries of 2 or 4 bytes,
+ *   padded to a multiple of 64 bytes,
+ * - the neighbour lists, order rows of order 32-bit nodes (order - 1
+ *   neighbours and one unused entry).
+ *
+ * The file is mapped read-only and shared, so loading costs no parsing and
+ * no copy, and concurrent processes on the same instance share the pages.
+ * The tables handed out point into the mapping, which lives as long as the
+ * cache object: they must not be written to.
+*/
+class InstanceCache {
+public:
+    struct Header {
+        char magic[8];
+        uint32_t byteOrder;     // BYTE_MARK as written, to reject foreign files
+        uint32_t version;
+        int32_t order;
+        int32_t stride;
+        int32_t entry;          // bytes per distance, 2 or 4
+        char unused[36];
+    };
+
+    static_assert(sizeof(Header) == Distances::ALIGN, "the table must start aligned");
+
+    static constexpr const char *MAGIC = "TSPCACHE";
+    static const uint32_t BYTE_MARK = 0x01020304;
+    static const uint32_t VERSION = 1;
+
+    /**
+     * Tell if a file is an instance cache, by its magic number.
+    */
+    static bool is_cache(const std::string &fname)
+    {
+        char magic[8];
+        FILE *f = fopen(fname.c_str(), "rb");
+        if (!f) {
+            return false;
+        }
+        bool found = fread(magic, 1, sizeof(magic), f) == sizeof(magic) && !memcmp(magic, MAGIC, sizeof(magic));
+        fclose(f);
+        return found;
+    }
+
+    /**
+     * Map a cache file. The program stops with a message if the file is not a valid cache.
+    */
+    explicit InstanceCache(const std::string &fname) : _fname(fname)
+    {
+        int fd = open(fname.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) < 0) {
+            abort(std::strerror(errno));
+        }
+        _size = st.st_size;
+        if (_size < sizeof(Header)) {
+            abort("truncated header");
+        }
+        _data = static_cast<char *>(mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0));
+        close(fd);
+        if (_data == MAP_FAILED) {
+            abort(std::strerror(errno));
+        }
+
+        const Header &h = header();
+        if (memcmp(h.magic, MAGIC, sizeof(h.magic)) || h.byteOrder != BYTE_MARK) {
+            abort("not an instance cache of this machine");
+        }
+        if (h.version != VERSION) {
+            abort("unsupported version " + std::to_string(h.version));
+        }
+        if (h.order < 1 || h.stride < h.order || h.stride % Distances::LANES || (h.entry != 2 && h.entry != 4)) {
+            abort("corrupted header");
+        }
+        if (_size < neighbours_offset() + (size_t) h.order * h.order * sizeof(int32_t)) {
+            abort("truncated tables");
+        }
+    }
+
+    ~InstanceCache() { munmap(_data, _size); }
+
+    InstanceCache(const InstanceCache &) = delete;
+    InstanceCache &operator=(const InstanceCache &) = delete;
+
+    int order() const { return header().order; }
+    int stride() const { return header().stride; }
+    bool narrow() const { return header().entry == 2; }
+
+    const void *distances() const { return _data + sizeof(Header); }
+
+    /**
+     * Get the neighbour lists, row i at i * order.
+    */
+    const int32_t *neighbours() const { return reinterpret_cast<const int32_t *>(_data + neighbours_offset()); }
+
+    /**
+     * Write a cache file.
+     * @param neighbours Function of a node giving its order - 1 neighbours by increasing distance.
+     * @return false if the file could not be written, errno telling why.
+    */
+    template <typename Neighbours>
+    static bool write(const std::string &fname, const Distances &distances, Neighbours neighbours)
+    {
+        int n = distances.order();
+        Header h;
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, MAGIC, sizeof(h.magic));
+        h.byteOrder = BYTE_MARK;
+        h.version = VERSION;
+        h.order = n;
+        h.stride = distances.stride();
+        h.entry = distances.narrow() ? 2 : 4;
+
+        FILE *f = fopen(fname.c_str(), "wb");
+        if (!f) {
+            return false;
+        }
+        bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+
+        // The padding of the rows goes along, so the table maps as is
+        size_t row = (size_t) h.stride * h.entry;
+        for (int i = 0; ok && i < n; i++) {
+            const void *data = distances.narrow() ? (const void *) distances.row16(i) : (const void *) distances.row32(i);
+            ok = fwrite(data, row, 1, f) == 1;
+        }
+        static const char zeros[Distances::ALIGN] = {};
+        size_t tail = table_size(n, h.stride, h.entry) - row * n;
+        ok = ok && (!tail || fwrite(zeros, tail, 1, f) == 1);
+
+        int32_t unused = -1;
+        for (int i = 0; ok && i < n; i++) {
+            ok = (n == 1 || fwrite(neighbours(i), sizeof(int32_t), n - 1, f) == (size_t) n - 1)
+                && fwrite(&unused, sizeof(unused), 1, f) == 1;
+        }
+        return fclose(f) == 0 && ok;
+    }
+
+private:
+    const Header &header() const { return *reinterpret_cast<const Header *>(_data); }
+
+    static size_t table_size(int order, int stride, int entry)
+    {
+        size_t size = (size_t) order * stride * entry;
+        return (size + Distances::ALIGN - 1) / Distances::ALIGN * Distances::ALIGN;
+    }
+
+    size_t neighbours_offset() const
+    {
+        return sizeof(Header) + table_size(header().order, header().stride, header().entry);
+    }
+
+    void abort(const std::string &message) const
+    {
+        std::cerr << _fname << ": " << message << std::endl;
+        exit(1);
+    }
+
+    std::string _fname;
+    char *_data;
+    size_t _size;
+};
+
+#endif // INSTANCE_CACHE_HPP
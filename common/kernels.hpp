@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <immintrin.h>
+
+#ifndef KERNELS_HPP
+#define KERNELS_HPP
+
+/**
+ * Row kernels of the lower bound: the two smallest and the sum of the
+ * entries of a distance row selected by a 64-bit mask (bit j selects
+ * entry j, so the row has at most 64 useful entries).
+ *
+ * Rows come from a Distances table, as 16-bit or 32-bit entries. The AVX2
+ * versions read the row in aligned blocks of 32 bytes and never past the
+ * last block holding a selected entry, which the padding of the table
+ * keeps inside the row. They are compiled with a target attribute and
+ * picked at run time, so the binary still runs on CPUs without AVX2.
+ * Sparse masks stay on the scalar loop, which only touches the selected entries.
+*/
+class Kernels {
+public:
+    /**
+     * Find the two smallest selected entries of a row.
+     * @param min Set to the smallest entry, INT_MAX if no entry is selected.
+     * @param min2 Set to the second smallest entry, INT_MAX if less than two are selected.
+    */
+    template <typename T>
+    static void two_min(const T *row, uint64_t mask, int &min, int &min2)
+    {
+        if (avx2() && __builtin_popcountll(mask) >= DENSE) {
+            two_min_avx2(row, mask, min, min2);
+        } else {
+            two_min_scalar(row, mask, min, min2);
+        }
+    }
+
+    /**
+     * Sum the selected entries of a row.
+    */
+    template <typename T>
+    static int masked_sum(const T *row, uint64_t mask)
+    {
+        if (avx2() && __builtin_popcountll(mask) >= DENSE) {
+            return masked_sum_avx2(row, mask);
+        }
+        return masked_sum_scalar(row, mask);
+    }
+
+    static bool avx2() { return _avx2; }
+
+    template <typename T>
+    static void two_min_scalar(const T *row, uint64_t mask, int &min, int &min2)
+    {
+        min = min2 = INT_MAX;
+        for (; mask; mask &= mask - 1) {
+            int d = row[__builtin_ctzll(mask)];
+            if (d < min) {
+                min2 = min;
+                min = d;
+            } else if (d < min2) {
+                min2 = d;
+            }
+        }
+    }
+
+    template <typename T>
+    static int masked_sum_scalar(const T *row, uint64_t mask)
+    {
+        int sum = 0;
+        for (; mask; mask &= mask - 1) {
+            sum += row[__builtin_ctzll(mask)];
+        }
+        return sum;
+    }
+
+    __attribute__((target("avx2")))
+    static void two_min_avx2(const int32_t *row, uint64_t mask, int &min, int &min2)
+    {
+        const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        const __m256i none = _mm256_set1_epi32(INT_MAX);
+        __m256i lo = none;
+        __m256i hi = none;
+        for (int k = 0; k < 64 && (mask >> k); k += 8) {
+            __m256i selected = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32((mask >> k) & 0xff), bits), bits);
+            __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i *>(row + k));
+            v = _mm256_blendv_epi8(none, v, selected);
+            hi = _mm256_min_epi32(hi, _mm256_max_epi32(lo, v));
+            lo = _mm256_min_epi32(lo, v);
+        }
+        alignas(32) int32_t los[8];
+        alignas(32) int32_t his[8];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(los), lo);
+        _mm256_store_si256(reinterpret_cast<__m256i *>(his), hi);
+        merge(los, his, 8, min, min2);
+    }
+
+    __attribute__((target("avx2")))
+    static void two_min_avx2(const int16_t *row, uint64_t mask, int &min, int &min2)
+    {
+        const __m256i bits = _mm256_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048,
+                                               4096, 8192, 16384, (short) 32768);
+        const __m256i none = _mm256_set1_epi16(INT16_MAX);
+        __m256i lo = none;
+        __m256i hi = none;
+        for (int k = 0; k < 64 && (mask >> k); k += 16) {
+            __m256i selected = _mm256_cmpeq_epi16(_mm256_and_si256(_mm256_set1_epi16((mask >> k) & 0xffff), bits), bits);
+            __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i *>(row + k));
+            v = _mm256_blendv_epi8(none, v, selected);
+            hi = _mm256_min_epi16(hi, _mm256_max_epi16(lo, v));
+            lo = _mm256_min_epi16(lo, v);
+        }
+        alignas(32) int16_t los16[16];
+        alignas(32) int16_t his16[16];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(los16), lo);
+        _mm256_store_si256(reinterpret_cast<__m256i *>(his16), hi);
+        int32_t los[16];
+        int32_t his[16];
+        for (int i = 0; i < 16; i++) {
+            los[i] = los16[i];
+            his[i] = his16[i];
+        }
+        merge(los, his, 16, min, min2);
+
+        // INT16_MAX is both a distance and the filler of the unselected lanes
+        int count = __builtin_popcountll(mask);
+        if (count < 2) {
+            min2 = INT_MAX;
+        }
+        if (count < 1) {
+            min = INT_MAX;
+        }
+    }
+
+    __attribute__((target("avx2")))
+    static int masked_sum_avx2(const int32_t *row, uint64_t mask)
+    {
+        const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        __m256i sum = _mm256_setzero_si256();
+        for (int k = 0; k < 64 && (mask >> k); k += 8) {
+            __m256i selected = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32((mask >> k) & 0xff), bits), bits);
+            __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i *>(row + k));
+            sum = _mm256_add_epi32(sum, _mm256_and_si256(v, selected));
+        }
+        return horizontal_sum(sum);
+    }
+
+    __attribute__((target("avx2")))
+    static int masked_sum_avx2(const int16_t *row, uint64_t mask)
+    {
+        const __m256i bits = _mm256_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048,
+                                               4096, 8192, 16384, (short) 32768);
+        const __m256i ones = _mm256_set1_epi16(1);
+        __m256i sum = _mm256_setzero_si256();
+        for (int k = 0; k < 64 && (mask >> k); k += 16) {
+            __m256i selected = _mm256_cmpeq_epi16(_mm256_and_si256(_mm256_set1_epi16((mask >> k) & 0xffff), bits), bits);
+            __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i *>(row + k));
+            // Pairs of 16-bit entries summed into 32-bit lanes, no overflow
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_and_si256(v, selected), ones));
+        }
+        return horizontal_sum(sum);
+    }
+
+private:
+    static const int DENSE = 8;     // fewer selected entries than this stay scalar
+
+    // Runs from a static initializer, possibly before the CPU model is known
+    static bool detect()
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    }
+
+    static inline const bool _avx2 = detect();
+
+    // Two smallest values over lanes holding their own two smallest values
+    static void merge(const int32_t *los, const int32_t *his, int lanes, int &min, int &min2)
+    {
+        min = min2 = INT_MAX;
+        for (int i = 0; i < lanes; i++) {
+            if (los[i] < min) {
+                min2 = std::min(min, his[i]);
+                min = los[i];
+            } else {
+                min2 = std::min(min2, los[i]);
+            }
+        }
+    }
+
+    __attribute__((target("avx2")))
+    static int horizontal_sum(__m256i sum)
+    {
+        __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(half);
+    }
+};
+
+#endif // KERNELS_HPP
@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "heldkarp.hpp"
+#include "heuristic.hpp"
+
+using namespace std;
+
+#define LARGEST 9
+#define RANDOM 20
+#define THREADS 3
+
+// Cost of the shortest tour, by trying every order of the nodes after node 0
+template <typename Distance>
+int brute_force(int order, Distance d)
+{
+    vector<int> tour(order);
+    for (int i = 0; i < order; i++)
+    {
+        tour[i] = i;
+    }
+    int best = Heuristic::cost(tour, d);
+    while (next_permutation(tour.begin() + 1, tour.end()))
+    {
+        best = min(best, Heuristic::cost(tour, d));
+    }
+    return best;
+}
+
+// Both solvers must return a tour visiting every node once, at the brute force cost
+template <typename Distance>
+bool check(const char *name, int order, Distance d)
+{
+    vector<int> identity(order);
+    for (int i = 0; i < order; i++)
+    {
+        identity[i] = i;
+    }
+    int upper = Heuristic::cost(identity, d);
+    int expected = brute_force(order, d);
+
+    bool passed = true;
+    vector<int> tours[2] = {
+        HeldKarp::solve(order, d, upper, THREADS),
+        HeldKarp::meet_in_the_middle(order, d, upper, THREADS),
+    };
+    for (int k = 0; k < 2; k++)
+    {
+        vector<int> sorted = tours[k];
+        sort(sorted.begin(), sorted.end());
+        if (sorted != identity || tours[k][0] != 0 || Heuristic::cost(tours[k], d) != expected)
+        {
+            cout << name << ", " << order << " nodes: " << (k ? "meet_in_the_middle" : "solve")
+                 << " found " << (sorted == identity ? Heuristic::cost(tours[k], d) : -1)
+                 << " instead of " << expected << endl;
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+int main()
+{
+    std::cout << "Hello tester!\n";
+
+    bool passed = true;
+
+    // Three nodes: the identity tour costs 300, the other way round 3
+    int three[3][3] = {{0, 100, 1},
+                       {1, 0, 100},
+                       {100, 1, 0}};
+    passed &= check("asymmetric", 3, [&](int i, int j) { return three[i][j]; });
+
+    // Random distances, different each way or not
+    srand(1);
+    for (int order = 1; order <= LARGEST; order++)
+    {
+        for (int n = 0; n < RANDOM; n++)
+        {
+            vector<int> d(order * order);
+            for (int i = 0; i < order; i++)
+            {
+                for (int j = 0; j < order; j++)
+                {
+                    d[i * order + j] = i == j ? 0 : 1 + rand() % 100;
+                }
+            }
+            passed &= check("asymmetric", order, [&](int i, int j) { return d[i * order + j]; });
+            passed &= check("symmetric", order, [&](int i, int j) { return d[min(i, j) * order + max(i, j)]; });
+        }
+    }
+
+    cout << (passed ? "Test passed" : "Test failed") << endl;
+
+    std::cout << "Goodbye, tester!\n";
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,33 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include "instance_cache.hpp"
+#include "../concurrent/tspfile.hpp"
+
+using namespace std;
+
+// Converts a TSPLIB file into an instance cache, which tspcc and tspmt
+// then map in place of the TSPLIB file: no parsing, distance or sorting.
+int main(int argc, char *argv[])
+{
+    if (argc != 3)
+    {
+        cerr << "usage: " << argv[0] << " tspfile cachefile" << endl;
+        return 1;
+    }
+
+    auto start = chrono::steady_clock::now();
+    Matrix *matrix = TSPFile::matrix(argv[1]);
+    matrix->update_neighbours();
+    if (!InstanceCache::write(argv[2], matrix->distances(), [&](int i) { return matrix->neighbours(i); }))
+    {
+        cerr << argv[2] << ": " << strerror(errno) << endl;
+        return 1;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << argv[2] << ": " << matrix->order() << " nodes, "
+         << (matrix->distances().narrow() ? 16 : 32) << "-bit distances, " << seconds << "s" << endl;
+    delete matrix;
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "heldkarp.hpp"
+#include "heuristic.hpp"
+#include "../concurrent/tspfile.hpp"
+
+using namespace std;
+
+// Exact solver by dynamic programming: the whole Held-Karp table if it fits
+// in the memory budget, else the half tours joined in the middle.
+// Prints the shortest tour and the time like tspmt.
+static int usage(const char *name)
+{
+    cout << "Usage: " << name << " [-v] [-m megabytes] <tsp file> <n threads=1>" << endl;
+    cout << "  -v  print the memory needed and the heuristic bound on stderr" << endl;
+    cout << "  -m  memory budget (default: the available memory)" << endl;
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    bool verbose = false;
+    size_t budget = HeldKarp::available_memory();
+    int opt;
+    while ((opt = getopt(argc, argv, "vm:")) != -1)
+    {
+        if (opt == 'v')
+        {
+            verbose = true;
+        }
+        else if (opt == 'm')
+        {
+            budget = stod(optarg) * 1e6;
+        }
+        else
+        {
+            return usage(argv[0]);
+        }
+    }
+    if (argc - optind < 1 || argc - optind > 2)
+    {
+        return usage(argv[0]);
+    }
+    Matrix *matrix = TSPFile::matrix(argv[optind]);
+    int nThreads = argc - optind == 2 ? stoi(argv[optind + 1]) : 1;
+    if (nThreads < 1)
+    {
+        return usage(argv[0]);
+    }
+
+    // Any tour bounds the costs kept in the table, the shorter the better.
+    // The local search assumes the same distances both ways.
+    auto distance = [matrix](int i, int j) { return matrix->distance(i, j); };
+    bool symmetric = Heuristic::symmetric(matrix->order(), distance);
+    vector<int> tour = Heuristic::nearest_neighbour(matrix->order(), distance);
+    if (symmetric)
+    {
+        Heuristic::improve(tour, distance);
+    }
+    int upper = Heuristic::cost(tour, distance);
+    size_t bytes = HeldKarp::table_bytes(matrix->order(), upper);
+    size_t halves = HeldKarp::halves_bytes(matrix->order(), upper, symmetric);
+    bool whole = bytes <= budget;
+    if (verbose)
+    {
+        cerr << "heuristic: " << upper << ", table: " << bytes / 1e6 << " MB, halves: " << halves / 1e6
+             << " MB, budget: " << budget / 1e6 << " MB" << endl;
+    }
+    if (!whole && halves > budget)
+    {
+        cerr << "Neither the table of " << bytes / 1e6 << " MB nor the halves of " << halves / 1e6
+             << " MB fit in " << budget / 1e6 << " MB, use tspmt" << endl;
+        return 1;
+    }
+
+    auto start = chrono::steady_clock::now();
+    tour = whole ? HeldKarp::solve(matrix->order(), distance, upper, nThreads)
+                 : HeldKarp::meet_in_the_middle(matrix->order(), distance, upper, nThreads);
+    chrono::duration<double> elapsedSeconds = chrono::steady_clock::now() - start;
+    if (tour.empty())
+    {
+        cerr << "Cannot allocate " << (whole ? bytes : halves) / 1e6 << " MB" << endl;
+        return 1;
+    }
+
+    cout << "[" << Heuristic::cost(tour, distance) << ": 0";
+    for (size_t i = 1; i <= tour.size(); i++)
+    {
+        cout << " -> " << tour[i % tour.size()];
+    }
+    cout << "]" << endl;
+    cout << nThreads << ";" << elapsedSeconds.count() << endl;
+    return 0;
+}
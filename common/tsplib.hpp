@@ -0,0 +1,494 @@
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef TSPLIB_HPP
+#define TSPLIB_HPP
+
+/**
+ * Loader of TSPLIB instances.
+ *
+ * Supported edge weights: EUC_2D, CEIL_2D, MAN_2D, MAX_2D, ATT and GEO from
+ * a NODE_COORD_SECTION, and EXPLICIT from an EDGE_WEIGHT_SECTION in any of
+ * the FULL_MATRIX, UPPER/LOWER(_DIAG)_ROW and UPPER/LOWER(_DIAG)_COL formats.
+ *
+ * The file is mapped in memory and parsed in place by a hand-written number
+ * scanner, with no limit on the number of nodes. Errors stop the program
+ * with the file name, the line number and a message.
+ *
+ * The distance table itself belongs to the callers: fill() hands every
+ * distance to a setter, computing coordinate distances in parallel rows,
+ * and streaming explicit weights from the mapped file as they are read.
+*/
+class TSPLib {
+private:
+    class Parser;
+
+public:
+    enum Weight { EUC_2D, CEIL_2D, MAN_2D, MAX_2D, ATT, GEO, EXPLICIT, UNKNOWN };
+
+    enum Format {
+        FULL_MATRIX, UPPER_ROW, LOWER_ROW, UPPER_DIAG_ROW, LOWER_DIAG_ROW,
+        UPPER_COL, LOWER_COL, UPPER_DIAG_COL, LOWER_DIAG_COL, NO_FORMAT
+    };
+
+    struct Point {
+        double x, y;
+    };
+
+    struct Instance {
+        int dimension = 0;
+        Weight weight = EUC_2D;
+        Format format = NO_FORMAT;
+        std::vector<Point> points;          // empty for EXPLICIT weights
+        std::shared_ptr<Parser> weights;    // at the first explicit weight, for fill()
+    };
+
+    /**
+     * Load an instance from a TSPLIB file.
+     * The coordinates are read; explicit weights are left in the mapped file for fill().
+    */
+    static Instance load(const std::string &fname)
+    {
+        std::shared_ptr<Parser> parser = std::make_shared<Parser>(fname);
+        Instance instance;
+
+        // Header, up to the section holding the distances
+        std::string key;
+        while (parser->keyword(key)) {
+            if (key == "NODE_COORD_SECTION" || key == "EDGE_WEIGHT_SECTION") {
+                break;
+            } else if (key == "DIMENSION") {
+                instance.dimension = (int) parser->number();
+                if (instance.dimension < 1) {
+                    parser->abort("wrong size in input");
+                }
+            } else if (key == "EDGE_WEIGHT_TYPE") {
+                instance.weight = weight(parser->word());
+            } else if (key == "EDGE_WEIGHT_FORMAT") {
+                instance.format = format(parser->word());
+            }
+            parser->next_line();
+        }
+        if (instance.weight == UNKNOWN) {
+            parser->abort("wrong EDGE_WEIGHT_TYPE parameter");
+        }
+
+        if (instance.weight == EXPLICIT) {
+            if (key != "EDGE_WEIGHT_SECTION") {
+                parser->abort("missing EDGE_WEIGHT_SECTION");
+            }
+            if (instance.format == NO_FORMAT) {
+                parser->abort("wrong EDGE_WEIGHT_FORMAT parameter");
+            }
+            parser->next_line();
+            instance.weights = parser;
+            return instance;
+        }
+
+        if (key != "NODE_COORD_SECTION") {
+            parser->abort("missing NODE_COORD_SECTION");
+        }
+        parser->next_line();
+        instance.points.resize(instance.dimension);
+        for (int i = 0; i < instance.dimension; i++) {
+            if ((int) parser->number() != i + 1) {
+                parser->abort("wrong data in input file");
+            }
+            instance.points[i].x = parser->number();
+            instance.points[i].y = parser->number();
+        }
+        return instance;
+    }
+
+    /**
+     * Hand every distance of the instance to set(i, j, distance), diagonal included.
+     * Coordinate distances are computed by several threads at once, each
+     * one setting whole rows, so set() must allow concurrent calls on
+     * distinct (i, j); explicit weights are set by the calling thread.
+    */
+    template <typename Set>
+    static void fill(const Instance &instance, Set set)
+    {
+        int n = instance.dimension;
+        if (instance.weight == EXPLICIT) {
+            fill_explicit(instance, set);
+        } else if (instance.weight == GEO) {
+            // Radians once per node, then four cosines and an arccosine per pair
+            std::vector<Point> radians(n);
+            for (int i = 0; i < n; i++) {
+                radians[i].x = instance.points[i].x * M_PI / 180.;
+                radians[i].y = instance.points[i].y * M_PI / 180.;
+            }
+            parallel_rows(n, [&](int i) {
+                for (int j = 0; j < n; j++) {
+                    set(i, j, i == j ? 0 : geo(radians[i], radians[j]));
+                }
+            });
+        } else {
+            parallel_rows(n, [&](int i) {
+                for (int j = 0; j < n; j++) {
+                    set(i, j, i == j ? 0 : distance(instance.weight, instance.points[i], instance.points[j]));
+                }
+            });
+        }
+    }
+
+    /**
+     * Get the distance between two nodes given by their coordinates, rounded as TSPLIB specifies.
+    */
+    static int distance(Weight weight, const Point &a, const Point &b)
+    {
+        double dx = a.x - b.x;
+        double dy = a.y - b.y;
+        switch (weight) {
+        case CEIL_2D:
+            return (int) ceil(sqrt(dx*dx + dy*dy));
+        case MAN_2D:
+            return (int) (.5 + fabs(dx) + fabs(dy));
+        case MAX_2D:
+            return std::max((int) (.5 + fabs(dx)), (int) (.5 + fabs(dy)));
+        case ATT: {
+            double r = sqrt((dx*dx + dy*dy) / 10.);
+            int t = (int) (.5 + r);
+            return t < r ? t + 1 : t;
+        }
+        case GEO: {
+            Point ra = { a.x * M_PI / 180., a.y * M_PI / 180. };
+            Point rb = { b.x * M_PI / 180., b.y * M_PI / 180. };
+            return geo(ra, rb);
+        }
+        default:
+            return (int) (.5 + sqrt(dx*dx + dy*dy));
+        }
+    }
+
+    /**
+     * Get an upper bound of every distance of the instance,
+     * so that the table can pick its entry size before it is filled.
+     * Explicit weights are unknown until read: the bound is 0.
+    */
+    static int max_distance(const Instance &instance)
+    {
+        if (instance.weight == EXPLICIT) {
+            return 0;
+        }
+        if (instance.weight == GEO) {
+            return 20100;   // half the circumference of the TSPLIB earth
+        }
+        double minX = HUGE_VAL, maxX = -HUGE_VAL, minY = HUGE_VAL, maxY = -HUGE_VAL;
+        for (const Point &p : instance.points) {
+            minX = std::min(minX, p.x);
+            maxX = std::max(maxX, p.x);
+            minY = std::min(minY, p.y);
+            maxY = std::max(maxY, p.y);
+        }
+        // The Manhattan distance bounds every other metric
+        double bound = (maxX - minX) + (maxY - minY) + 1;
+        return bound < 2e9 ? (int) bound : 2000000000;
+    }
+
+    /**
+     * Call row(i) for every i in [0, n), spreading the rows over the cores.
+     * Rows are dealt round-robin, so the threads get similar loads even
+     * when the cost of a row depends on its index.
+    */
+    template <typename Row>
+    static void parallel_rows(int n, Row row)
+    {
+        int nThreads = std::max(1, std::min((int) std::thread::hardware_concurrency(), n / 64));
+        std::vector<std::thread> threads;
+        for (int t = 1; t < nThreads; t++) {
+            threads.emplace_back([=]() {
+                for (int i = t; i < n; i += nThreads) {
+                    row(i);
+                }
+            });
+        }
+        for (int i = 0; i < n; i += nThreads) {
+            row(i);
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+    }
+
+private:
+    static Weight weight(const std::string &value)
+    {
+        static const char *names[] = { "EUC_2D", "CEIL_2D", "MAN_2D", "MAX_2D", "ATT", "GEO", "EXPLICIT" };
+        for (int w = EUC_2D; w < UNKNOWN; w++) {
+            if (value == names[w]) {
+                return (Weight) w;
+            }
+        }
+        return UNKNOWN;
+    }
+
+    static Format format(const std::string &value)
+    {
+        static const char *names[] = {
+            "FULL_MATRIX", "UPPER_ROW", "LOWER_ROW", "UPPER_DIAG_ROW", "LOWER_DIAG_ROW",
+            "UPPER_COL", "LOWER_COL", "UPPER_DIAG_COL", "LOWER_DIAG_COL"
+        };
+        for (int f = FULL_MATRIX; f < NO_FORMAT; f++) {
+            if (value == names[f]) {
+                return (Format) f;
+            }
+        }
+        return NO_FORMAT;
+    }
+
+    // TSPLIB GEO distance between two points given in radians
+    static int geo(const Point &a, const Point &b)
+    {
+        double RRR = 6378.388;
+        double q1 = cos(a.x - b.x);
+        double q2 = cos(a.y - b.y);
+        double q3 = cos(a.y + b.y);
+        return (int) (RRR * acos( ( (q1+1)*q2 - (q1-1)*q3 ) /2 ) + .5);
+    }
+
+    /**
+     * Read the weights in the order of the format. The weights of a
+     * triangle are set in both directions; the column formats of one
+     * triangle list the same sequence as the row formats of the other.
+    */
+    template <typename Set>
+    static void fill_explicit(const Instance &instance, Set set)
+    {
+        Parser &parser = *instance.weights;
+        int n = instance.dimension;
+        bool upper = false;
+        bool diagonal = false;
+        switch (instance.format) {
+        case FULL_MATRIX:
+            for (int i = 0; i < n; i++) {
+                for (int j = 0; j < n; j++) {
+                    set(i, j, (int) parser.number());
+                }
+            }
+            return;
+        case UPPER_ROW: case LOWER_COL:
+            upper = true;
+            break;
+        case UPPER_DIAG_ROW: case LOWER_DIAG_COL:
+            upper = diagonal = true;
+            break;
+        case LOWER_ROW: case UPPER_COL:
+            break;
+        case LOWER_DIAG_ROW: case UPPER_DIAG_COL:
+            diagonal = true;
+            break;
+        default:
+            parser.abort("wrong EDGE_WEIGHT_FORMAT parameter");
+        }
+
+        for (int i = 0; i < n; i++) {
+            if (!diagonal) {
+                set(i, i, 0);
+            }
+            int from = upper ? (diagonal ? i : i + 1) : 0;
+            int to = upper ? n : (diagonal ? i + 1 : i);
+            for (int j = from; j < to; j++) {
+                int d = (int) parser.number();
+                set(i, j, d);
+                set(j, i, d);
+            }
+        }
+    }
+
+    /**
+     * Cursor over a memory-mapped file.
+    */
+    class Parser {
+    public:
+        explicit Parser(const std::string &fname) : _fname(fname)
+        {
+            int fd = open(fname.c_str(), O_RDONLY);
+            struct stat st;
+            if (fd < 0 || fstat(fd, &st) < 0) {
+                fail(std::strerror(errno));
+            }
+            _size = st.st_size;
+            _data = _size ? static_cast<const char *>(mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0)) : "";
+            close(fd);
+            if (_data == MAP_FAILED) {
+                fail(std::strerror(errno));
+            }
+            if (_size) {
+                madvise(const_cast<char *>(_data), _size, MADV_SEQUENTIAL);
+            }
+            _p = _data;
+            _end = _data + _size;
+        }
+
+        ~Parser()
+        {
+            if (_size) {
+                munmap(const_cast<char *>(_data), _size);
+            }
+        }
+
+        Parser(const Parser &) = delete;
+        Parser &operator=(const Parser &) = delete;
+
+        /**
+         * Read the keyword starting the next non-empty line, and the colon after it if any.
+         * @return false at the end of the file.
+        */
+        bool keyword(std::string &key)
+        {
+            skip_space(true);
+            if (_p == _end) {
+                return false;
+            }
+            const char *start = _p;
+            while (_p < _end && (isalnum((unsigned char) *_p) || *_p == '_')) {
+                _p++;
+            }
+            key.assign(start, _p);
+            skip_space(false);
+            if (_p < _end && *_p == ':') {
+                _p++;
+            }
+            return true;
+        }
+
+        /**
+         * Read the next word on the current line.
+        */
+        std::string word()
+        {
+            skip_space(false);
+            const char *start = _p;
+            while (_p < _end && !isspace((unsigned char) *_p)) {
+                _p++;
+            }
+            return std::string(start, _p);
+        }
+
+        void next_line()
+        {
+            while (_p < _end && *_p != '\n') {
+                _p++;
+            }
+            if (_p < _end) {
+                _p++;
+            }
+        }
+
+        /**
+         * Read a decimal number, with optional sign, fraction and exponent.
+         * Up to 19 significant digits and a power of ten within 1e22 are
+         * converted exactly; longer numbers go through strtod.
+        */
+        double number()
+        {
+            skip_space(true);
+            const char *start = _p;
+            bool negative = false;
+            if (_p < _end && (*_p == '-' || *_p == '+')) {
+                negative = *_p++ == '-';
+            }
+
+            uint64_t mantissa = 0;
+            int digits = 0;
+            int scale = 0;
+            bool any = false;
+            for (; _p < _end && isdigit((unsigned char) *_p); _p++, any = true) {
+                if (digits < 19) {
+                    mantissa = mantissa * 10 + (*_p - '0');
+                    digits += mantissa > 0;
+                } else {
+                    scale++;
+                }
+            }
+            if (_p < _end && *_p == '.') {
+                for (_p++; _p < _end && isdigit((unsigned char) *_p); _p++, any = true) {
+                    if (digits < 19) {
+                        mantissa = mantissa * 10 + (*_p - '0');
+                        digits += mantissa > 0;
+                        scale--;
+                    }
+                }
+            }
+            if (!any) {
+                abort("missing data in input file");
+            }
+            if (_p < _end && (*_p == 'e' || *_p == 'E')) {
+                _p++;
+                bool negativeExponent = false;
+                if (_p < _end && (*_p == '-' || *_p == '+')) {
+                    negativeExponent = *_p++ == '-';
+                }
+                int exponent = 0;
+                for (; _p < _end && isdigit((unsigned char) *_p); _p++) {
+                    exponent = std::min(exponent * 10 + (*_p - '0'), 100000);
+                }
+                scale += negativeExponent ? -exponent : exponent;
+            }
+
+            double value;
+            if (mantissa < (1ULL << 53) && scale >= -22 && scale <= 22) {
+                value = scale < 0 ? mantissa / power(-scale) : mantissa * power(scale);
+            } else {
+                value = strtod(std::string(start, _p).c_str(), nullptr);
+                negative = false;
+            }
+            return negative ? -value : value;
+        }
+
+        /**
+         * Stop the program with the current line number.
+        */
+        void abort(const std::string &message)
+        {
+            int line = 1 + std::count(_data, _p, '\n');
+            std::cerr << "Line " << line << " in " << _fname << ": " << message << '\n';
+            exit(1);
+        }
+
+    private:
+        void fail(const char *error)
+        {
+            std::cerr << _fname << '(' << error << ")\n";
+            exit(1);
+        }
+
+        void skip_space(bool newlines)
+        {
+            while (_p < _end && isspace((unsigned char) *_p) && (newlines || *_p != '\n')) {
+                _p++;
+            }
+        }
+
+        static double power(int n)
+        {
+            static const double powers[] = {
+                1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+            };
+            return powers[n];
+        }
+
+        std::string _fname;
+        const char *_data;
+        const char *_p;
+        const char *_end;
+        size_t _size;
+    };
+};
+
+#endif // TSPLIB_HPP
@@ -5,25 +5,38 @@
 #ifndef BNB_HPP
 #define BNB_HPP
 
+/**
+ * Rule choosing the edge to branch on.
+ * FIRST:   first unused edge in row-major order.
+ * NEAREST: first node with unused edges, to its nearest unused neighbour.
+ * STRONG:  edge whose exclusion raises the lower bound the most.
+ * FEWEST:  node with the fewest unused edges, to its nearest unused neighbour.
+*/
+enum Branching { FIRST, NEAREST, STRONG, FEWEST };
+
 // Branch and bound algorithm
 class BnB {
 public:
-    explicit BnB(EdgeMatrix edges) {
-        _leftMatrix = edges;
-        _rightMatrix = edges;
+    BnB(const Matrix *matrix, const Path &path, Branching rule = NEAREST)
+        : _matrix(matrix), _rule(rule), _left(path), _right(path)
+    {
+        _left.descend();
+        _right.descend();
         generate_childs();
     }
 
-    EdgeMatrix left() const { return _leftMatrix; }
-    EdgeMatrix right() const { return _rightMatrix; }
+    const Path &left() const { return _left; }
+    const Path &right() const { return _right; }
 
 private:
     /**
      * Generate the childs of the current path.
-     * The left child is generated by including the next unused edge to the path.
-     * The right child is generated by excluding the next unused edge from the path.
+     * The branching edge is chosen by the branching rule.
+     * The left child is generated by including the branching edge in the path.
+     * The right child is generated by excluding the branching edge from the path.
      * 
-     * When a child is generated, we must check the following:
+     * When a child is generated, the following rules are applied
+     * until none of them changes the child anymore:
      * 1. If excluding edge(i, j) from the path make it impossible
      *    for node i or j to have as many as two edges in the path,
      *    then edge(i, j) must be included in the path.
@@ -32,88 +45,190 @@ private:
      * 3. If including edge(i, j) would cause the path to have a
      *    partial cycle, then edge(i, j) must be excluded.
      * 
+     * Both childs are copies of the parent path, updated in place:
+     * only the nodes touched by the branching edge are revisited.
+     * 
      * Reminder: 0 = unused, 1 = included, -1 = excluded
     */
     void generate_childs() {
-        // Find the next unused edge
-        int i = 0;
-        int j = 0;
-        bool found = false;
-        for (i = 0; i < _leftMatrix.size(); i++) {
-            for (j = 0; j < _leftMatrix.size(); j++) {
-                if (_leftMatrix[i][j] == 0 && i != j) {
-                    found = true;
-                    break;
-                }
+        const EdgeMatrix &edges = _left.edge_matrix();
+
+        int i = -1;
+        int j = -1;
+        switch (_rule) {
+        case FIRST:
+            i = first_node(edges);
+            if (i >= 0) {
+                j = __builtin_ctzll(edges.unused(i));
+            }
+            break;
+        case NEAREST:
+            i = first_node(edges);
+            if (i >= 0) {
+                j = nearest(edges, i);
             }
-            if (found) {
-                break;
+            break;
+        case STRONG:
+            strongest(_left, i, j);
+            break;
+        case FEWEST:
+            i = fewest_node(edges);
+            if (i >= 0) {
+                j = nearest(edges, i);
             }
+            break;
         }
 
-        if (!found) {
+        if (i < 0) {
             return;
         }
 
-        // Include the next unused edge in the left child
-        _leftMatrix[i][j] = 1;
-        _leftMatrix[j][i] = 1;
-        update_child(_leftMatrix);
+        // Include the branching edge in the left child
+        RowMask dirty = 0;
+        if (include(_left, i, j, dirty)) {
+            update_child(_left, dirty);
+        }
 
-        // Exclude the next unused edge in the right child
-        _rightMatrix[i][j] = -1;
-        _rightMatrix[j][i] = -1;
-        update_child(_rightMatrix);
+        // Exclude the branching edge in the right child
+        dirty = 0;
+        if (exclude(_right, i, j, dirty)) {
+            update_child(_right, dirty);
+        }
     }
 
-    void update_child(EdgeMatrix &child) {
-        // Compute the number of used edges for each node
-        // and the number of unused edges for each node
-        std::vector<int> usedEdges(child.size(), 0);
-        std::vector<int> unusedEdges(child.size(), 0);
-
-        for (int i = 0; i < child.size(); i++) {
-            for (int j = i+1; j < child.size(); j++) {
-                if (child[i][j] == 1) {
-                    usedEdges[i]++;
-                    usedEdges[j]++;
-                } else if (child[i][j] == 0) {
-                    unusedEdges[i]++;
-                    unusedEdges[j]++;
-                }
+    // First node with unused edges, or -1 if every edge is decided
+    static int first_node(const EdgeMatrix &edges) {
+        for (int i = 0; i < edges.order(); i++) {
+            if (edges.unused(i)) {
+                return i;
             }
         }
+        return -1;
+    }
 
-        // If node i has 1 used edge and 1 unused edge,
-        // or 0 used edge and 2 unused edges,
-        // then the unused edge must be included in the path.
-        // If node i has 2 used egdes, then the unused edges must be excluded.
-        for (int i = 0; i < child.size(); i++) {
-            if ((usedEdges[i] == 1 && unusedEdges[i] == 1) ||
-                (usedEdges[i] == 0 && unusedEdges[i] == 2)) {
-                for (int j = i+1; j < child.size(); j++) {
-                    if (child[i][j] == 0 && i != j && unusedEdges[j] >= 1 && usedEdges[j] <= 1) {
-                        child[i][j] = 1;
-                        child[j][i] = 1;
-                        break;
-                    }
-                }
+    // Node with the fewest unused edges, or -1 if every edge is decided
+    static int fewest_node(const EdgeMatrix &edges) {
+        int best = -1;
+        int fewest = EdgeMatrix::MAX_ORDER + 1;
+        for (int i = 0; i < edges.order(); i++) {
+            int count = __builtin_popcountll(edges.unused(i));
+            if (count > 0 && count < fewest) {
+                best = i;
+                fewest = count;
             }
+        }
+        return best;
+    }
+
+    // Nearest unused neighbour of node i, which must have one
+    int nearest(const EdgeMatrix &edges, int i) const {
+        RowMask unused = edges.unused(i);
+        const int *neighbours = _matrix->neighbours(i);
+        int k = 0;
+        while (!(unused & EdgeMatrix::bit(neighbours[k]))) {
+            k++;
+        }
+        return neighbours[k];
+    }
 
-            if (usedEdges[i] == 2) {
-                for (int j = i+1; j < child.size(); j++) {
-                    if (child[i][j] == 0 && i != j) {
-                        child[i][j] = -1;
-                        child[j][i] = -1;
-                    }
+    /**
+     * Find the unused edge whose exclusion raises the lower bound the most.
+     * Excluding (i, j) only changes the bound if j is one of the two nearest
+     * unused neighbours of i, so only those edges are evaluated.
+     * Ties go to the shortest edge.
+    */
+    void strongest(const Path &path, int &bestI, int &bestJ) const {
+        const EdgeMatrix &edges = path.edge_matrix();
+        int bestGain = -1;
+        bestI = bestJ = -1;
+        for (int i = 0; i < edges.order(); i++) {
+            RowMask unused = edges.unused(i);
+            const int *neighbours = _matrix->neighbours(i);
+            int candidates = std::min(2, __builtin_popcountll(unused));
+            for (int k = 0, found = 0; found < candidates; k++) {
+                int j = neighbours[k];
+                if (!(unused & EdgeMatrix::bit(j))) {
+                    continue;
+                }
+                found++;
+                int gain = path.exclusion_gain(i, j);
+                if (gain > bestGain || (gain == bestGain && _matrix->distance(i, j) < _matrix->distance(bestI, bestJ))) {
+                    bestGain = gain;
+                    bestI = i;
+                    bestJ = j;
                 }
             }
         }
+    }
 
+    /**
+     * Include the edge (i, j) in the child and mark the nodes to revisit.
+     * The edge joins two fragments into one: unless it is the last edge of
+     * the tour, the edge between the two ends of the new fragment would close
+     * a subtour, so it is excluded right away.
+     * @return true if the child is still valid, false otherwise.
+    */
+    static bool include(Path &child, int i, int j, RowMask &dirty) {
+        int a = child.fragment_end(i);
+        int b = child.fragment_end(j);
+        if (!child.include(i, j)) {
+            return false;
+        }
+        dirty |= EdgeMatrix::bit(i) | EdgeMatrix::bit(j);
+        // a and b are the ends of the new fragment; (a, b) is the edge itself if it joined two single nodes
+        if (!child.complete() && child.edge_matrix().get(a, b) == 0 && child.included_edges() + 1 < child.edge_matrix().order()) {
+            return exclude(child, a, b, dirty);
+        }
+        return true;
+    }
+
+    /**
+     * Exclude the edge (i, j) from the child and mark the nodes to revisit.
+     * @return true if the child is still valid, false otherwise.
+    */
+    static bool exclude(Path &child, int i, int j, RowMask &dirty) {
+        dirty |= EdgeMatrix::bit(i) | EdgeMatrix::bit(j);
+        return child.exclude(i, j);
+    }
+
+    /**
+     * Propagate the degree constraints until nothing changes.
+     * Every node whose edges changed is put back in the dirty set:
+     * If node i has 2 included edges, its unused edges must be excluded.
+     * If node i has 1 included edge and 1 unused edge,
+     * or 0 included edge and 2 unused edges,
+     * then the unused edges must be included in the path.
+     * A child found infeasible on the way is left invalid and never queued.
+    */
+    static void update_child(Path &child, RowMask dirty) {
+        const EdgeMatrix &edges = child.edge_matrix();
+
+        while (dirty && child.valid()) {
+            int i = __builtin_ctzll(dirty);
+            dirty &= dirty - 1;
+
+            RowMask unused = edges.unused(i);
+            if (!unused) {
+                continue;
+            }
+
+            int used = child.degree(i);
+            if (used == 2) {
+                for (; unused && child.valid(); unused &= unused - 1) {
+                    exclude(child, i, __builtin_ctzll(unused), dirty);
+                }
+            } else if (used + __builtin_popcountll(unused) == 2) {
+                for (; unused && child.valid(); unused &= unused - 1) {
+                    include(child, i, __builtin_ctzll(unused), dirty);
+                }
+            }
+        }
     }
 
-    EdgeMatrix _leftMatrix;
-    EdgeMatrix _rightMatrix;
+    const Matrix *_matrix;
+    Branching _rule;
+    Path _left;
+    Path _right;
 };
 
-#endif // BNB_HPP
\ No newline at end of file
+#endif // BNB_HPP
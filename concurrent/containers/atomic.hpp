@@ -38,7 +38,7 @@ public:
 		c.pair.stamp = stamp;
 		n.pair.ptr = next;
 		n.pair.stamp = nstamp;
-		bool res = __atomic_compare_exchange(&ref.val, &c.val, &n.val, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+		bool res = __atomic_compare_exchange(&ref.val, &c.val, &n.val, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
 		return res;
 	}
 
@@ -49,7 +49,7 @@ public:
 	T* get(uint64_t &stamp)
 	{
 		__ref u;
-		__atomic_load(&ref.val, &u.val, __ATOMIC_RELAXED);
+		__atomic_load(&ref.val, &u.val, __ATOMIC_ACQUIRE);
 		stamp = u.pair.stamp;
 		return u.pair.ptr;
 	}
@@ -61,7 +61,7 @@ public:
 		__ref u;
 		u.pair.ptr = ptr;
 		u.pair.stamp = stamp;
-		__atomic_store(&ref.val, &u.val, __ATOMIC_RELAXED);
+		__atomic_store(&ref.val, &u.val, __ATOMIC_RELEASE);
 	}
 
 };
@@ -0,0 +1,149 @@
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include "stack.hpp"
+#include "deque.hpp"
+
+using namespace std;
+
+// Binary tree of DEPTH levels, WORK iterations of busy work per node.
+// Items are encoded as depth + 1, 0 being the empty value of both containers.
+#define DEPTH 18
+#define WORK 200
+#define MAX_THREADS 256
+
+static atomic<long> pending;
+static atomic<long> processed;
+
+static void work(long item)
+{
+    volatile long sink = item;
+    for (int i = 0; i < WORK; ++i)
+    {
+        sink = sink * 31 + i;
+    }
+}
+
+/** Global Treiber stack, as used by tspmt so far **/
+
+static ConcurrentStack<long> *stack;
+
+static void stack_worker()
+{
+    while (pending > 0)
+    {
+        long item = stack->pop();
+        if (item == 0)
+        {
+            this_thread::yield();
+            continue;
+        }
+        work(item);
+        if (item <= DEPTH)
+        {
+            pending += 2;
+            stack->push(item + 1);
+            stack->push(item + 1);
+        }
+        processed++;
+        pending--;
+    }
+}
+
+/** One Chase-Lev deque per worker **/
+
+static WorkStealingDeque<long> *deques;
+static int nDeques;
+
+static void deque_worker(int tid)
+{
+    uint32_t seed = 2463534242u + tid;
+    while (pending > 0)
+    {
+        long item = deques[tid].pop();
+        for (int i = 0; item == 0 && i < nDeques; ++i)
+        {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            int victim = seed % nDeques;
+            if (victim != tid)
+            {
+                item = deques[victim].steal();
+            }
+        }
+        if (item == 0)
+        {
+            this_thread::yield();
+            continue;
+        }
+        work(item);
+        if (item <= DEPTH)
+        {
+            pending += 2;
+            deques[tid].push(item + 1);
+            deques[tid].push(item + 1);
+        }
+        processed++;
+        pending--;
+    }
+}
+
+static double run(int nThreads, bool useDeques)
+{
+    unique_ptr<thread[]> threads(new thread[nThreads]);
+    pending = 1;
+    processed = 0;
+    if (useDeques)
+    {
+        nDeques = nThreads;
+        deques = new WorkStealingDeque<long>[nThreads];
+        deques[0].push(1);
+    }
+    else
+    {
+        stack = new ConcurrentStack<long>();
+        stack->push(1);
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < nThreads; ++i)
+    {
+        threads[i] = useDeques ? thread(deque_worker, i) : thread(stack_worker);
+    }
+    for (int i = 0; i < nThreads; ++i)
+    {
+        threads[i].join();
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    if (useDeques)
+    {
+        delete[] deques;
+    }
+    else
+    {
+        delete stack;
+    }
+
+    if (processed != (2L << DEPTH) - 1)
+    {
+        cerr << "wrong number of nodes: " << processed << endl;
+        exit(1);
+    }
+    return elapsed.count();
+}
+
+int main()
+{
+    cout << "threads;stack;deque" << endl;
+    for (int nThreads = 1; nThreads <= MAX_THREADS; nThreads *= 2)
+    {
+        double stackTime = run(nThreads, false);
+        double dequeTime = run(nThreads, true);
+        cout << nThreads << ";" << stackTime << ";" << dequeTime << endl;
+    }
+    return 0;
+}
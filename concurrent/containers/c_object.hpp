@@ -2,8 +2,15 @@
 #define C_OBJECT_HPP
 
 #include "atomic.hpp"
+#include "epoch.hpp"
 #include <iostream>
 
+/**
+ * Concurrent pointer to a heap object owned by the CObject.
+ * set() replaces the object and retires the previous one through Epoch,
+ * so a thread dereferencing the result of get() must hold an Epoch::Guard
+ * for as long as it uses it.
+*/
 template <typename T>
 class CObject {
 private:
@@ -18,6 +25,30 @@ public:
         while (!object.cas(expected, value, stamp, stamp + 1)) {
             expected = object.get(stamp);
         }
+        if (expected != nullptr && expected != value) {
+            Epoch::retire(expected);
+        }
+    }
+
+    /**
+     * Replace the object by value as long as replace(current) holds.
+     * @return true if value was stored, false if replace() refused the current object.
+    */
+    template <typename Predicate>
+    bool set_if(T* value, Predicate replace) {
+        Epoch::Guard guard;
+        uint64_t stamp = 0;
+        T* expected = object.get(stamp);
+        while (replace(expected)) {
+            if (object.cas(expected, value, stamp, stamp + 1)) {
+                if (expected != nullptr && expected != value) {
+                    Epoch::retire(expected);
+                }
+                return true;
+            }
+            expected = object.get(stamp);
+        }
+        return false;
     }
 
     T* get() {
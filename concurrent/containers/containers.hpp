@@ -3,7 +3,10 @@
 
 #include "atomic.hpp"
 #include "../../sequential/path.hpp"
+#include <atomic>
+#include <climits>
 #include <iostream>
+#include <mutex>
 
 const int SIZE = 10;
 
@@ -14,6 +17,10 @@ private:
     atomic_stamped<bool> finished;
     // Shortest path found so far
     atomic_stamped<Path> shortestPath;
+    // Its distance, alone in its cache line: the bound test only loads it
+    alignas(64) std::atomic<int> shortestDistance;
+    // Serialises the copies into the shortest path
+    alignas(64) std::mutex shortestLock;
     // Verified path
     atomic_stamped<int> verifiedPath;
     // Table of thread statuses
@@ -21,7 +28,7 @@ private:
     atomic_stamped<int*> threadStatus;
 
 public:
-    Container() : finished(0, 0), shortestPath(nullptr, 0), verifiedPath(0, 0), threadStatus(threadStatusTable, 0) {}
+    Container() : finished(0, 0), shortestPath(nullptr, 0), shortestDistance(INT_MAX), verifiedPath(0, 0), threadStatus(threadStatusTable, 0) {}
 
     /** finished **/
     void set_finished(bool* value) {
@@ -41,16 +48,39 @@ public:
 
     /** shortestPath **/
     void set_path(Path* path) {
+        std::lock_guard<std::mutex> lock(shortestLock);
         uint64_t stamp = 0;
         Path* expected = shortestPath.get(stamp);
         while (!shortestPath.cas(expected, path, stamp, stamp + 1)) {
             expected = shortestPath.get(stamp);
         }
+        shortestDistance.store(path ? path->distance() : INT_MAX, std::memory_order_relaxed);
     }
 
-    Path get_path() {
+    Path* get_path() {
         uint64_t stamp = 0;
-        return *shortestPath.get(stamp);
+        return shortestPath.get(stamp);
+    }
+
+    // Distance of the shortest path, to bound against
+    int get_distance() const {
+        return shortestDistance.load(std::memory_order_relaxed);
+    }
+
+    // Copy path into the shortest path if it is shorter; the caller keeps path.
+    // A path must have been set first.
+    bool offer_path(Path* path) {
+        int distance = path->distance();
+        if (distance >= get_distance()) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(shortestLock);
+        if (distance >= get_distance()) {
+            return false;
+        }
+        get_path()->copy(path);
+        shortestDistance.store(distance, std::memory_order_relaxed);
+        return true;
     }
 
     void print_path() {
@@ -0,0 +1,149 @@
+#ifndef WORK_STEALING_DEQUE_HPP
+#define WORK_STEALING_DEQUE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Chase-Lev work-stealing deque.
+ * The owner thread pushes and pops at the bottom (LIFO), other threads
+ * steal from the top (FIFO), so thieves take the oldest items.
+ * T must be trivially copyable; T() is returned when nothing was taken.
+ *
+ * Memory orderings follow Le, Pop, Cohen and Zappa Nardelli,
+ * "Correct and Efficient Work-Stealing for Weak Memory Models" (PPoPP'13).
+*/
+template <typename T>
+class WorkStealingDeque
+{
+private:
+    struct Array
+    {
+        int64_t capacity;
+        std::atomic<T> *buffer;
+
+        explicit Array(int64_t capacity) : capacity(capacity), buffer(new std::atomic<T>[capacity]) {}
+        ~Array() { delete[] buffer; }
+
+        T get(int64_t i) const { return buffer[i & (capacity - 1)].load(std::memory_order_relaxed); }
+        void put(int64_t i, T value) { buffer[i & (capacity - 1)].store(value, std::memory_order_relaxed); }
+
+        Array *grow(int64_t bottom, int64_t top) const
+        {
+            Array *array = new Array(2 * capacity);
+            for (int64_t i = top; i < bottom; i++)
+            {
+                array->put(i, get(i));
+            }
+            return array;
+        }
+    };
+
+    alignas(64) std::atomic<int64_t> _top;
+    alignas(64) std::atomic<int64_t> _bottom;
+    alignas(64) std::atomic<Array *> _array;
+
+    // Arrays replaced by grow() may still be read by a thief,
+    // they are only freed with the deque.
+    std::vector<Array *> _retired;
+
+public:
+    explicit WorkStealingDeque(int64_t capacity = 1024) : _top(0), _bottom(0), _array(new Array(capacity)) {}
+
+    ~WorkStealingDeque()
+    {
+        delete _array.load(std::memory_order_relaxed);
+        for (Array *array : _retired)
+        {
+            delete array;
+        }
+    }
+
+    WorkStealingDeque(const WorkStealingDeque &) = delete;
+    WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+    // Owner only
+    void push(const T value)
+    {
+        int64_t bottom = _bottom.load(std::memory_order_relaxed);
+        int64_t top = _top.load(std::memory_order_acquire);
+        Array *array = _array.load(std::memory_order_relaxed);
+
+        if (bottom - top > array->capacity - 1)
+        {
+            _retired.push_back(array);
+            array = array->grow(bottom, top);
+            _array.store(array, std::memory_order_release);
+        }
+
+        array->put(bottom, value);
+        std::atomic_thread_fence(std::memory_order_release);
+        _bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    // Owner only
+    T pop()
+    {
+        int64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+        Array *array = _array.load(std::memory_order_relaxed);
+        _bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = _top.load(std::memory_order_relaxed);
+
+        if (top > bottom)
+        {
+            // Empty
+            _bottom.store(bottom + 1, std::memory_order_relaxed);
+            return T();
+        }
+
+        T value = array->get(bottom);
+        if (top == bottom)
+        {
+            // Last item, race against the thieves
+            if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                value = T();
+            }
+            _bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return value;
+    }
+
+    // Any thread
+    T steal()
+    {
+        int64_t top = _top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = _bottom.load(std::memory_order_acquire);
+
+        if (top >= bottom)
+        {
+            return T();
+        }
+
+        Array *array = _array.load(std::memory_order_acquire);
+        T value = array->get(top);
+        if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            // Lost the race against the owner or another thief
+            return T();
+        }
+        return value;
+    }
+
+    bool empty() const
+    {
+        return size() <= 0;
+    }
+
+    int64_t size() const
+    {
+        int64_t bottom = _bottom.load(std::memory_order_relaxed);
+        int64_t top = _top.load(std::memory_order_relaxed);
+        return bottom - top;
+    }
+};
+
+#endif
@@ -0,0 +1,205 @@
+#ifndef EPOCH_HPP
+#define EPOCH_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Epoch-based memory reclamation (Fraser, "Practical lock-freedom", 2004).
+ *
+ * A thread reading shared lock-free objects does it inside a Guard, which
+ * announces the global epoch it started in. An object unlinked from a shared
+ * structure is not deleted but retired: it is only freed once the global
+ * epoch has moved twice, that is once every thread that could still hold a
+ * pointer to it has left its guard. The global epoch moves when every thread
+ * inside a guard has seen the current one.
+ *
+ * Usage:
+ *     {
+ *         Epoch::Guard guard;
+ *         Node *node = top.get(...);   // safe to dereference until the guard ends
+ *         ...
+ *     }
+ *     Epoch::retire(node);            // instead of delete node
+*/
+class Epoch
+{
+private:
+    static const int RETIRE_SCAN = 64;  // retires between two attempts to advance
+
+    struct Retired
+    {
+        void *pointer;
+        void (*deleter)(void *);
+    };
+
+    struct alignas(64) Record
+    {
+        std::atomic<uint64_t> state;    // (epoch << 1) | 1 inside a guard, 0 outside
+        std::atomic<bool> used;         // claimed by a live thread
+        Record *next;
+        int depth;                      // nested guards
+        int retires;
+        uint64_t limboEpoch[3];
+        std::vector<Retired> limbo[3];  // retired objects, by epoch modulo 3
+
+        Record() : state(0), used(true), next(nullptr), depth(0), retires(0), limboEpoch{0, 0, 0} {}
+    };
+
+    struct Handle
+    {
+        Record *record = nullptr;
+
+        // The retired objects stay in the record, for the next thread claiming it
+        ~Handle()
+        {
+            if (record)
+            {
+                record->state.store(0, std::memory_order_release);
+                record->used.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    static std::atomic<uint64_t> &global()
+    {
+        static std::atomic<uint64_t> *epoch = new std::atomic<uint64_t>(2);
+        return *epoch;
+    }
+
+    static std::atomic<Record *> &records()
+    {
+        static std::atomic<Record *> *head = new std::atomic<Record *>(nullptr);
+        return *head;
+    }
+
+    // Record of the calling thread, reusing the one of a finished thread if any
+    static Record *local()
+    {
+        static thread_local Handle handle;
+        if (handle.record)
+        {
+            return handle.record;
+        }
+
+        for (Record *record = records().load(std::memory_order_acquire); record; record = record->next)
+        {
+            if (!record->used.load(std::memory_order_relaxed) && !record->used.exchange(true, std::memory_order_acquire))
+            {
+                handle.record = record;
+                return record;
+            }
+        }
+
+        Record *record = new Record();
+        Record *head = records().load(std::memory_order_relaxed);
+        do
+        {
+            record->next = head;
+        } while (!records().compare_exchange_weak(head, record, std::memory_order_release, std::memory_order_relaxed));
+        handle.record = record;
+        return record;
+    }
+
+    static void free(std::vector<Retired> &limbo)
+    {
+        for (Retired &retired : limbo)
+        {
+            retired.deleter(retired.pointer);
+        }
+        limbo.clear();
+    }
+
+    // Move the global epoch if every thread inside a guard has seen it
+    static void try_advance()
+    {
+        uint64_t epoch = global().load(std::memory_order_acquire);
+        for (Record *record = records().load(std::memory_order_acquire); record; record = record->next)
+        {
+            uint64_t state = record->state.load(std::memory_order_acquire);
+            if ((state & 1) && (state >> 1) != epoch)
+            {
+                return;
+            }
+        }
+        global().compare_exchange_strong(epoch, epoch + 1, std::memory_order_acq_rel, std::memory_order_relaxed);
+    }
+
+    // Free the objects retired two epochs ago or earlier
+    static void collect(Record *record)
+    {
+        uint64_t epoch = global().load(std::memory_order_acquire);
+        for (int i = 0; i < 3; i++)
+        {
+            if (!record->limbo[i].empty() && record->limboEpoch[i] + 2 <= epoch)
+            {
+                free(record->limbo[i]);
+            }
+        }
+    }
+
+public:
+    class Guard
+    {
+    public:
+        Guard() { enter(); }
+        ~Guard() { leave(); }
+
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+    };
+
+    static void enter()
+    {
+        Record *record = local();
+        if (record->depth++ == 0)
+        {
+            uint64_t epoch = global().load(std::memory_order_relaxed);
+            record->state.store((epoch << 1) | 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    static void leave()
+    {
+        Record *record = local();
+        if (--record->depth == 0)
+        {
+            record->state.store(0, std::memory_order_release);
+        }
+    }
+
+    /**
+     * Delete the object once no guarded thread can reach it anymore.
+     * The object must already be unlinked from every shared structure.
+    */
+    static void retire(void *pointer, void (*deleter)(void *))
+    {
+        Record *record = local();
+        uint64_t epoch = global().load(std::memory_order_acquire);
+        int slot = epoch % 3;
+        if (record->limboEpoch[slot] != epoch)
+        {
+            // The slot holds objects of epoch - 3 or earlier
+            free(record->limbo[slot]);
+            record->limboEpoch[slot] = epoch;
+        }
+        record->limbo[slot].push_back(Retired{pointer, deleter});
+
+        if (++record->retires >= RETIRE_SCAN)
+        {
+            record->retires = 0;
+            try_advance();
+            collect(record);
+        }
+    }
+
+    template <typename T>
+    static void retire(T *pointer)
+    {
+        retire(pointer, [](void *p) { delete static_cast<T *>(p); });
+    }
+};
+
+#endif
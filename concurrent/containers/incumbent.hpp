@@ -0,0 +1,60 @@
+#ifndef INCUMBENT_HPP
+#define INCUMBENT_HPP
+
+#include <atomic>
+#include <climits>
+#include "c_object.hpp"
+
+/**
+ * Best solution found so far, shared by all the threads.
+ *
+ * The cost of the best solution sits alone in its cache line and only ever
+ * decreases (CAS-min), so the pruning test is a single relaxed load.
+ * The solution itself is published separately in a CObject, and only
+ * replaced by a cheaper one, so two threads racing cannot put back a worse one.
+ *
+ * T must provide int cost().
+*/
+template <typename T>
+class Incumbent {
+private:
+    alignas(64) std::atomic<int> _cost;
+    alignas(64) CObject<T> _best;
+
+public:
+    Incumbent() : _cost(INT_MAX) {}
+
+    /**
+     * Cost of the best solution, to prune against.
+    */
+    int cost() const { return _cost.load(std::memory_order_relaxed); }
+
+    /**
+     * Offer a solution. The incumbent takes ownership of it,
+     * and deletes it if it is not strictly better than the current one.
+     * @return true if the solution became the incumbent.
+    */
+    bool offer(T* solution) {
+        int cost = solution->cost();
+        int current = _cost.load(std::memory_order_relaxed);
+        while (cost < current) {
+            if (_cost.compare_exchange_weak(current, cost, std::memory_order_relaxed)) {
+                // A cheaper solution may have been published meanwhile
+                if (_best.set_if(solution, [cost](T* best) { return best == nullptr || cost < best->cost(); })) {
+                    return true;
+                }
+                break;
+            }
+        }
+        delete solution;
+        return false;
+    }
+
+    /**
+     * Best solution found so far.
+     * Must be dereferenced under an Epoch::Guard while other threads may offer.
+    */
+    T* get() { return _best.get(); }
+};
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef MULTIQUEUE_HPP
+#define MULTIQUEUE_HPP
+
+#include <atomic>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * Relaxed concurrent priority queue (MultiQueue, Rihani, Sanders and Dementiev, SPAA'15).
+ * Items are spread over several sequential binary heaps, each protected by a spin lock.
+ * push() inserts into a random heap; pop() looks at the minimum of two random heaps
+ * and removes the smaller one. pop() does not always return the global minimum,
+ * but returns a value close to it while threads rarely contend on the same heap.
+ * Smaller keys have a higher priority. T() is returned when every heap is empty.
+*/
+template <typename T>
+class MultiQueue
+{
+private:
+    struct Item
+    {
+        int key;
+        T value;
+
+        bool operator<(const Item &other) const { return key > other.key; }
+    };
+
+    struct alignas(64) Queue
+    {
+        std::atomic<bool> locked;
+        std::atomic<int> top;   // key of the minimum, INT_MAX when empty
+        std::vector<Item> heap;
+
+        Queue() : locked(false), top(INT_MAX) {}
+
+        bool try_lock()
+        {
+            return !locked.load(std::memory_order_relaxed) &&
+                   !locked.exchange(true, std::memory_order_acquire);
+        }
+
+        void unlock()
+        {
+            top.store(heap.empty() ? INT_MAX : heap.front().key, std::memory_order_relaxed);
+            locked.store(false, std::memory_order_release);
+        }
+    };
+
+    int _nQueues;
+    std::unique_ptr<Queue[]> _queues;
+
+    static uint32_t random()
+    {
+        static thread_local uint32_t seed = 2463534242u ^ (uint32_t)(uintptr_t)&seed;
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    }
+
+    T pop_locked(Queue &queue)
+    {
+        T value = T();
+        if (!queue.heap.empty())
+        {
+            std::pop_heap(queue.heap.begin(), queue.heap.end());
+            value = queue.heap.back().value;
+            queue.heap.pop_back();
+        }
+        queue.unlock();
+        return value;
+    }
+
+public:
+    explicit MultiQueue(int nQueues) : _nQueues(nQueues), _queues(new Queue[nQueues]) {}
+
+    MultiQueue(const MultiQueue &) = delete;
+    MultiQueue &operator=(const MultiQueue &) = delete;
+
+    void push(int key, const T value)
+    {
+        while (true)
+        {
+            Queue &queue = _queues[random() % _nQueues];
+            if (queue.try_lock())
+            {
+                queue.heap.push_back(Item{key, value});
+                std::push_heap(queue.heap.begin(), queue.heap.end());
+                queue.unlock();
+                return;
+            }
+        }
+    }
+
+    T pop()
+    {
+        // Two random choices, a few times
+        for (int attempt = 0; attempt < 4; attempt++)
+        {
+            Queue &first = _queues[random() % _nQueues];
+            Queue &second = _queues[random() % _nQueues];
+            Queue &queue = first.top.load(std::memory_order_relaxed) <= second.top.load(std::memory_order_relaxed) ? first : second;
+            if (queue.top.load(std::memory_order_relaxed) == INT_MAX)
+            {
+                continue;
+            }
+            if (queue.try_lock())
+            {
+                T value = pop_locked(queue);
+                if (value != T())
+                {
+                    return value;
+                }
+            }
+        }
+
+        // Looks empty, scan every heap before giving up
+        int start = random() % _nQueues;
+        for (int i = 0; i < _nQueues; i++)
+        {
+            Queue &queue = _queues[(start + i) % _nQueues];
+            while (queue.top.load(std::memory_order_relaxed) != INT_MAX)
+            {
+                if (queue.try_lock())
+                {
+                    T value = pop_locked(queue);
+                    if (value != T())
+                    {
+                        return value;
+                    }
+                }
+            }
+        }
+        return T();
+    }
+
+    bool empty() const
+    {
+        for (int i = 0; i < _nQueues; i++)
+        {
+            if (_queues[i].top.load(std::memory_order_relaxed) != INT_MAX)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+#endif
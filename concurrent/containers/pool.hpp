@@ -0,0 +1,163 @@
+#ifndef POOL_HPP
+#define POOL_HPP
+
+#include <atomic>
+#include <cstdlib>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+
+/**
+ * Number of heap allocations made by all the pools.
+ * Once the pools are warm it stops growing.
+*/
+inline std::atomic<long> &pool_chunks()
+{
+    static std::atomic<long> *chunks = new std::atomic<long>(0);
+    return *chunks;
+}
+
+/**
+ * Fixed-size object pool for T, with one free list per thread.
+ *
+ * A thread allocates from and releases to its own free list, without any
+ * synchronisation. Objects can be released by another thread than the one
+ * that allocated them: when a free list grows past two batches, one batch
+ * moves to a shared depot, where threads running short take it back.
+ * The heap is only used to create new chunks of objects when the depot is empty.
+ *
+ * Memory is never given back to the system; the pool outlives every thread
+ * and every static object.
+ *
+ * Use it through operator new / operator delete of the pooled class:
+ *     static void *operator new(size_t) { return Pool<T>::allocate(); }
+ *     static void operator delete(void *p) { Pool<T>::release(p); }
+*/
+template <typename T>
+class Pool
+{
+private:
+    static const int BATCH = 64;
+    static const int CHUNK = 256;
+
+    struct Block
+    {
+        Block *next;
+    };
+
+    static const size_t ALIGN = alignof(T) > alignof(Block) ? alignof(T) : alignof(Block);
+    static const size_t SIZE = ((sizeof(T) > sizeof(Block) ? sizeof(T) : sizeof(Block)) + ALIGN - 1) / ALIGN * ALIGN;
+
+    struct Depot
+    {
+        std::mutex mutex;
+        std::vector<Block *> batches;
+    };
+
+    struct Cache
+    {
+        Block *head = nullptr;
+        int count = 0;
+
+        ~Cache()
+        {
+            if (head)
+            {
+                std::lock_guard<std::mutex> lock(depot().mutex);
+                depot().batches.push_back(head);
+            }
+        }
+    };
+
+    static Depot &depot()
+    {
+        static Depot *depot = new Depot();
+        return *depot;
+    }
+
+    static Cache &cache()
+    {
+        static thread_local Cache cache;
+        return cache;
+    }
+
+    // Fill an empty cache, from the depot if possible, from the heap otherwise
+    static void refill(Cache &cache)
+    {
+        {
+            std::lock_guard<std::mutex> lock(depot().mutex);
+            if (!depot().batches.empty())
+            {
+                cache.head = depot().batches.back();
+                depot().batches.pop_back();
+                cache.count = 0;
+                for (Block *block = cache.head; block; block = block->next)
+                {
+                    cache.count++;
+                }
+                return;
+            }
+        }
+
+        char *chunk = static_cast<char *>(std::aligned_alloc(ALIGN, SIZE * CHUNK));
+        if (!chunk)
+        {
+            throw std::bad_alloc();
+        }
+        pool_chunks().fetch_add(1, std::memory_order_relaxed);
+        for (int i = CHUNK - 1; i >= 0; i--)
+        {
+            Block *block = reinterpret_cast<Block *>(chunk + i * SIZE);
+            block->next = cache.head;
+            cache.head = block;
+        }
+        cache.count = CHUNK;
+    }
+
+public:
+    static void *allocate()
+    {
+        Cache &local = cache();
+        if (!local.head)
+        {
+            refill(local);
+        }
+        Block *block = local.head;
+        local.head = block->next;
+        local.count--;
+        return block;
+    }
+
+    static void release(void *pointer)
+    {
+        if (!pointer)
+        {
+            return;
+        }
+        Cache &local = cache();
+        Block *block = static_cast<Block *>(pointer);
+        block->next = local.head;
+        local.head = block;
+        local.count++;
+
+        if (local.count >= 2 * BATCH)
+        {
+            // Hand one batch over to the other threads
+            Block *batch = local.head;
+            Block *last = batch;
+            for (int i = 1; i < BATCH; i++)
+            {
+                last = last->next;
+            }
+            local.head = last->next;
+            local.count -= BATCH;
+            last->next = nullptr;
+
+            std::lock_guard<std::mutex> lock(depot().mutex);
+            depot().batches.push_back(batch);
+        }
+    }
+};
+
+#endif
@@ -3,6 +3,8 @@
 
 #include <memory>
 #include "atomic.hpp"
+#include "pool.hpp"
+#include "epoch.hpp"
 
 template <typename T>
 class ConcurrentStack
@@ -14,6 +16,9 @@ public:
         Node *next;
 
         Node(const T value) : value(value), next(nullptr) {}
+
+        static void *operator new(size_t) { return Pool<Node>::allocate(); }
+        static void operator delete(void *pointer) { Pool<Node>::release(pointer); }
     };
 
     atomic_stamped<Node> top;
@@ -39,6 +44,8 @@ public:
 
     T pop()
     {
+        // current_top may be popped by another thread while we read its next
+        Epoch::Guard guard;
         uint64_t stamp = 0;
         while (true)
         {
@@ -47,7 +54,7 @@ public:
             if (current_top == nullptr)
             {
                 //printf("Stack is empty\n");
-                return nullptr;
+                return T();
                 //continue;
             }
             Node* new_top = current_top->next;
@@ -55,7 +62,7 @@ public:
             if (top.cas(current_top, new_top, stamp, stamp + 1))
             {
                 auto data = current_top->value;
-                delete current_top;
+                Epoch::retire(current_top);
                 return data;
             }
         }
@@ -70,6 +77,7 @@ public:
 
     int size()
     {
+        Epoch::Guard guard;
         uint64_t stamp = 0;
         Node* current_top = top.get(stamp);
         int size = 0;
@@ -0,0 +1,89 @@
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include "deque.hpp"
+
+using namespace std;
+
+#define NUMBER 100000
+#define THIEVES 3
+
+WorkStealingDeque<int> deque(16);
+atomic<int> taken[NUMBER + 1];
+atomic<bool> finished(false);
+
+void owner_thread()
+{
+    // Push everything, popping back one item out of three
+    for (int i = 1; i <= NUMBER; ++i)
+    {
+        deque.push(i);
+        if (i % 3 == 0)
+        {
+            int value = deque.pop();
+            if (value)
+            {
+                taken[value]++;
+            }
+        }
+    }
+
+    int value;
+    while ((value = deque.pop()) != 0)
+    {
+        taken[value]++;
+    }
+    finished = true;
+}
+
+void thief_thread()
+{
+    while (!finished || !deque.empty())
+    {
+        int value = deque.steal();
+        if (value)
+        {
+            taken[value]++;
+        }
+    }
+}
+
+int main()
+{
+    std::cout << "Hello tester!\n";
+
+    for (int i = 0; i <= NUMBER; ++i)
+    {
+        taken[i] = 0;
+    }
+
+    thread owner(owner_thread);
+    thread thieves[THIEVES];
+    for (int i = 0; i < THIEVES; ++i)
+    {
+        thieves[i] = thread(thief_thread);
+    }
+
+    owner.join();
+    for (int i = 0; i < THIEVES; ++i)
+    {
+        thieves[i].join();
+    }
+
+    // Every item must have been taken exactly once
+    bool passed = deque.empty();
+    for (int i = 1; i <= NUMBER; ++i)
+    {
+        if (taken[i] != 1)
+        {
+            printf("item %d taken %d times\n", i, taken[i].load());
+            passed = false;
+        }
+    }
+
+    cout << (passed ? "Test passed" : "Test failed") << endl;
+
+    std::cout << "Goodbye, tester!\n";
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+#include <cstdint>
+#include <cstring>
+
+#ifndef EDGE_MATRIX_HPP
+#define EDGE_MATRIX_HPP
+
+/**
+ * Bit mask over the nodes of a graph, one bit per node.
+ * Bit j of a row mask is set when the edge (i, j) is in the given state.
+*/
+typedef uint64_t RowMask;
+
+/**
+ * The edge matrix represents the state of the edges of a path.
+ * An edge (i, j) is either unused (0), included in the path (1),
+ * or excluded from the path (-1).
+ *
+ * The states are kept in two symmetric bit matrices, one for the included
+ * edges and one for the excluded edges, each row being a single 64-bit word.
+ * The whole matrix lives in one flat block without any heap allocation,
+ * so copying a subproblem is a plain memcpy.
+ *
+ * The rows are sized for MAX_ORDER nodes whatever the order, about 1 KB per
+ * matrix: a fixed size keeps Path a fixed-size object for its pool and
+ * the copy free of any allocation, which costs more than the unused rows.
+*/
+class EdgeMatrix {
+public:
+    static const int MAX_ORDER = 64;
+
+    explicit EdgeMatrix(int order = 0) : _order(order) {
+        std::memset(_included, 0, sizeof(_included));
+        std::memset(_excluded, 0, sizeof(_excluded));
+    }
+
+    int order() const { return _order; }
+
+    /**
+     * Get the state of the edge (i, j).
+     * @return 1 if included, -1 if excluded, 0 if unused (or if i == j).
+    */
+    int get(int i, int j) const {
+        if (_included[i] & bit(j)) {
+            return 1;
+        }
+        if (_excluded[i] & bit(j)) {
+            return -1;
+        }
+        return 0;
+    }
+
+    /**
+     * Set the state of the edge (i, j), and of (j, i) by symmetry.
+     * The diagonal is always unused and cannot be set.
+    */
+    void set(int i, int j, int state) {
+        if (i == j) {
+            return;
+        }
+        _included[i] &= ~bit(j);
+        _included[j] &= ~bit(i);
+        _excluded[i] &= ~bit(j);
+        _excluded[j] &= ~bit(i);
+        if (state == 1) {
+            _included[i] |= bit(j);
+            _included[j] |= bit(i);
+        } else if (state == -1) {
+            _excluded[i] |= bit(j);
+            _excluded[j] |= bit(i);
+        }
+    }
+
+    RowMask included(int i) const { return _included[i]; }
+    RowMask excluded(int i) const { return _excluded[i]; }
+
+    /**
+     * Get the unused edges of node i, the diagonal excepted.
+    */
+    RowMask unused(int i) const {
+        return all() & ~(_included[i] | _excluded[i] | bit(i));
+    }
+
+    /**
+     * Mask with one bit set for every node of the graph.
+    */
+    RowMask all() const {
+        return _order == MAX_ORDER ? ~RowMask(0) : (RowMask(1) << _order) - 1;
+    }
+
+    static RowMask bit(int i) { return RowMask(1) << i; }
+
+private:
+    int _order;
+    RowMask _included[MAX_ORDER];
+    RowMask _excluded[MAX_ORDER];
+};
+
+#endif // EDGE_MATRIX_HPP
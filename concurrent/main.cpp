@@ -4,122 +4,249 @@
 #include <mutex>
 #include <atomic>
 #include <cstdint>
-
-#include <stack>
-#include <queue>
+#include <cstring>
+#include <algorithm>
+#include <deque>
+#include <vector>
+#include <unistd.h>
 
 #include "matrix.hpp"
 #include "tspfile.hpp"
 #include "path.hpp"
 #include "bnb.hpp"
-#include "containers/stack.hpp"
-#include "containers/c_object.hpp"
+#include "scheduler.hpp"
+#include "containers/incumbent.hpp"
+#include "../common/heuristic.hpp"
+#include "../common/heldkarp.hpp"
+
+enum Bound { PAIR, ONE_TREE };
+
+enum Engine { AUTO, BRANCH_AND_BOUND, DYNAMIC };
 
-// Create a struct containing a bool and a table of 300 ints
-struct Status {
-    bool keepRunning;
-    int threadStatus[300];
+// Largest Held-Karp work (entries times their cost) the automatic engine
+// choice gives to dynamic programming: about a second on one core
+static const double DP_WORK = 1 << 30;
+
+// Search options, set from the command line
+static struct {
+    Strategy strategy;
+    int depth;      // depth of the best-first part of the hybrid strategy
+    Bound bound;    // lower bound of the subproblems
+    Branching branching;    // rule choosing the branching edge
+    bool verbose;   // print statistics on stderr
+    const char *tourFile;   // initial incumbent, instead of the heuristic tour
+    Engine engine;  // exact solver
+    int frontier;   // open paths per thread expanded before the workers start
+} config = { DEPTH_FIRST, 8, PAIR, NEAREST, false, nullptr, BRANCH_AND_BOUND, 4 };
+
+// Search statistics, one cache line per thread
+struct alignas(64) Counters {
+    long expanded;  // paths branched on
+    long pruned;    // children cut by their lower bound
 };
 
-ConcurrentStack<Path*> paths;
-CObject<Status> runningStatus;
 
-CObject<Path> best;
+Scheduler *scheduler;
 
-void solve(Matrix *pMatrix, int tid)
-{
-    Path * path = nullptr;
-    while (runningStatus.get()->keepRunning) {
+Incumbent<Path> best;
 
-        path = paths.pop();
+Counters *counters;
 
-        if (path == nullptr) {
-            runningStatus.get()->threadStatus[tid] = 0; // I'm free!
+// Workers that got their first path, and when the last one did
+std::atomic<int> busyThreads(0);
+std::chrono::steady_clock::time_point allBusy;
 
-            int status = 0;
-            for (int i = 0; i < 300; i++) {
-                status += runningStatus.get()->threadStatus[i];
-            }
+/**
+ * Copy a child path unless its lower bound shows it cannot beat the best tour.
+ * The cheap bound is checked first, the Held-Karp bound only on the survivors.
+ * @return the copy, or nullptr if the child is pruned.
+*/
+Path *survivor(int tid, const Path &child)
+{
+    if (!child.valid() || child.lower_bound() >= best.cost()) {
+        counters[tid].pruned++;
+        return nullptr;
+    }
+    Path *path = new Path(child);
+    if (config.bound == ONE_TREE && (!path->tighten(best.cost()) || path->lower_bound() >= best.cost())) {
+        counters[tid].pruned++;
+        delete path;
+        return nullptr;
+    }
+    return path;
+}
 
-            if (status == 0) {
-                runningStatus.get()->keepRunning = false;
-            }
+/**
+ * Queue a child path unless it is pruned.
+*/
+void branch(int tid, const Path &child)
+{
+    Path *path = survivor(tid, child);
+    if (path != nullptr) {
+        scheduler->push(tid, path);
+    }
+}
+
+/**
+ * Expand the tree breadth first from the root until there are count open
+ * paths, or none left. Complete tours found on the way are offered to the incumbent.
+ * @return the open paths, sorted by increasing lower bound.
+*/
+std::vector<Path *> frontier(Matrix *pMatrix, Path *root, size_t count)
+{
+    std::deque<Path *> open(1, root);
+    while (!open.empty() && open.size() < count) {
+        Path *path = open.front();
+        open.pop_front();
+        if (path->complete()) {
+            best.offer(path);
             continue;
         }
-        runningStatus.get()->threadStatus[tid] = 1; // I'm enslaved...
-
-        if (path->valid() && path->complete()) {
-            if (path->cost() <= best.get()->cost()) {
-                best.set(path);
-                continue;
+        BnB bnb(pMatrix, *path, config.branching);
+        counters[0].expanded++;
+        for (const Path *child : { &bnb.left(), &bnb.right() }) {
+            Path *next = survivor(0, *child);
+            if (next != nullptr) {
+                open.push_back(next);
             }
         }
+        delete path;
+    }
 
-        if (path->valid() && !path->complete()) {
-            BnB bnb(path->edge_matrix());
-            Path *left = new Path(pMatrix, bnb.left());
-            Path *right = new Path(pMatrix, bnb.right());
+    std::vector<Path *> paths(open.begin(), open.end());
+    std::stable_sort(paths.begin(), paths.end(), [](const Path *a, const Path *b) {
+        return a->lower_bound() < b->lower_bound();
+    });
+    return paths;
+}
 
-            if (left->lower_bound() <= best.get()->cost()) {
-                paths.push(left);
-            } else {
-                delete left;
+void solve(Matrix *pMatrix, int tid)
+{
+    Path * path = nullptr;
+    bool busy = false;
+    while ((path = scheduler->next(tid)) != nullptr) {
+        if (!busy) {
+            busy = true;
+            if (busyThreads.fetch_add(1) + 1 == scheduler->threads()) {
+                allBusy = std::chrono::steady_clock::now();
             }
+        }
 
-            if (right->lower_bound() <= best.get()->cost()) {
-                paths.push(right);
-            } else {
-                delete right;
-            }
+        if (path->valid() && path->complete()) {
+            best.offer(path);
+            scheduler->done();
+            continue;
+        }
+
+        if (path->valid()) {
+            // The include child is pushed last, so depth first explores it first
+            BnB bnb(pMatrix, *path, config.branching);
+            counters[tid].expanded++;
+            branch(tid, bnb.right());
+            branch(tid, bnb.left());
         }
 
         delete path;
         path = nullptr;
+        scheduler->done();
+    }
+}
+
+/**
+ * Build the complete path of a tour.
+*/
+Path *tour_path(Matrix *pMatrix, const std::vector<int> &tour) {
+    EdgeMatrix edgeMatrix(pMatrix->order());
+    for (int i = 0; i < pMatrix->order(); i++) {
+        for (int j = 0; j < pMatrix->order(); j++) {
+            if (i != j) {
+                edgeMatrix.set(i, j, -1);
+            }
+        }
+    }
+    for (size_t i = 0; i < tour.size(); i++) {
+        edgeMatrix.set(tour[i], tour[(i + 1) % tour.size()], 1);
+    }
+    return new Path(pMatrix, edgeMatrix);
+}
+
+/**
+ * Tell if the instance goes to dynamic programming: on request, or
+ * automatically when it is quick and its table takes at most half the available memory.
+*/
+bool use_dynamic(int order, int upper) {
+    size_t bytes = HeldKarp::table_bytes(order, upper);
+    size_t available = HeldKarp::available_memory();
+    if (config.engine == DYNAMIC && bytes > available) {
+        std::cerr << "The Held-Karp table of " << bytes / 1e6 << " MB does not fit in "
+                  << available / 1e6 << " MB" << std::endl;
+        exit(1);
     }
+    return config.engine == DYNAMIC
+        || (config.engine == AUTO && HeldKarp::work(order) <= DP_WORK && bytes <= available / 2);
 }
 
 void start_tsp(Matrix *pMatrix, int nThreads) {
     std::chrono::steady_clock::time_point start, end;
 
-    EdgeMatrix rootEdges(pMatrix->order(), std::vector<int>(pMatrix->order(), 0));
-    Path *root = new Path(pMatrix, rootEdges);
-    paths.push(root);
-
-    // Generate initial path
-    EdgeMatrix edgeMatrix(pMatrix->order(), std::vector<int>(pMatrix->order(), -1));
+    scheduler = new Scheduler(nThreads, config.strategy, config.depth);
+    counters = new Counters[nThreads]();
+    Path *root = new Path(pMatrix);
 
-    // Generate initial path 0 -> 1 -> 2 -> ... -> n -> 0
-    // EdgeMatrix will look like this:
-    //      0    1    2    3    4
-    // 0    0    1    -1   -1   1
-    // 1    1    0    1    -1   -1
-    // 2    -1   1    0    1    -1
-    // 3    -1   -1   1    0    1
-    // 4    1    -1   -1   1    0
+    // Initial incumbent: a heuristic tour, or the tour given on the command line
+    auto distance = [pMatrix](int i, int j) { return pMatrix->distance(i, j); };
+    start = std::chrono::steady_clock::now();
+    std::vector<int> tour = config.tourFile ? Heuristic::read_tour(config.tourFile, pMatrix->order())
+                                            : Heuristic::nearest_neighbour(pMatrix->order(), distance);
+    Heuristic::improve(tour, distance);
+    end = std::chrono::steady_clock::now();
+    std::chrono::duration<double> heuristicSeconds = end - start;
+    std::cerr << "heuristic: " << Heuristic::cost(tour, distance) << " in " << heuristicSeconds.count() << "s" << std::endl;
 
-    for (int i = 0; i < pMatrix->order(); i++) {
-        for (int j = 0; j < pMatrix->order(); j++) {
-            if (i == j) {
-                edgeMatrix[i][j] = 0;
-            } else if (i == j+1 || i+1 == j) {
-                edgeMatrix[i][j] = 1;
-            } else if ((i == 0 && j == pMatrix->order()-1) || (i == pMatrix->order()-1 && j == 0)) {
-                edgeMatrix[i][j] = 1;
-            } else {
-                edgeMatrix[i][j] = -1;
-            }
+    // Below three cities the only tour has fewer than three edges, so the
+    // edge branching never completes it: the DP returns it directly
+    if (pMatrix->order() < 3 || use_dynamic(pMatrix->order(), Heuristic::cost(tour, distance))) {
+        if (config.verbose) {
+            std::cerr << "engine: dynamic programming" << std::endl;
+        }
+        start = std::chrono::steady_clock::now();
+        tour = HeldKarp::solve(pMatrix->order(), distance, Heuristic::cost(tour, distance), nThreads);
+        end = std::chrono::steady_clock::now();
+        if (tour.empty()) {
+            std::cerr << "Cannot allocate the Held-Karp table" << std::endl;
+            exit(1);
+        }
+        std::cout << "[" << Heuristic::cost(tour, distance) << ": 0";
+        for (size_t i = 1; i <= tour.size(); i++) {
+            std::cout << " -> " << tour[i % tour.size()];
         }
+        std::cout << "]" << std::endl;
+        std::chrono::duration<double> elapsedSeconds = end - start;
+        std::cout << nThreads << ";" << elapsedSeconds.count() << std::endl;
+        return;
     }
 
-    Path *path = new Path(pMatrix, edgeMatrix);
-    best.set(path);
-    std::thread threads[nThreads];
-    for (int i = 0; i < 300; i++) {
-        // 1 = running, 0 = stopped
-        runningStatus.get()->threadStatus[i] = i < nThreads ? 1 : 0;
+    pMatrix->update_neighbours();
+    best.offer(tour_path(pMatrix, tour));
+
+    // The root gets more subgradient steps: its penalties seed the whole tree
+    if (config.bound == ONE_TREE) {
+        root->tighten(best.cost(), OneTree::ROOT_ITERATIONS);
+        if (config.verbose) {
+            std::cerr << "root bound: " << root->lower_bound() << std::endl;
+        }
     }
-    runningStatus.get()->keepRunning = true;
+
+    // Deal the most promising paths first, round robin. Each deque is LIFO,
+    // so the paths are pushed from the least promising one.
     start = std::chrono::steady_clock::now();
+    std::vector<Path *> open = frontier(pMatrix, root, (size_t) config.frontier * nThreads);
+    for (size_t i = open.size(); i-- > 0; ) {
+        scheduler->push(i % nThreads, open[i]);
+    }
+    std::chrono::duration<double> frontierSeconds = std::chrono::steady_clock::now() - start;
+
+    std::thread threads[nThreads];
     for (int i = 0; i < nThreads; i++) {
         threads[i] = std::thread(solve, pMatrix, i);
     }
@@ -131,21 +258,119 @@ void start_tsp(Matrix *pMatrix, int nThreads) {
     //std::cout << "Best path: ";
     best.get()->display();
     //std::cout << "Time: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms" << std::endl;
-    //std::cout << (paths.empty() ? "Empty" : "NOT EMPTY ????????") << std::endl;
     std::chrono::duration<double>elapsedSeconds = end - start;
     std::cout<<nThreads<<";"<<elapsedSeconds.count()<<std::endl;
+
+    if (config.verbose) {
+        long expanded = 0;
+        long pruned = 0;
+        for (int i = 0; i < nThreads; i++) {
+            expanded += counters[i].expanded;
+            pruned += counters[i].pruned;
+        }
+        std::cerr << "frontier: " << open.size() << " paths in " << frontierSeconds.count() << "s, ";
+        if (busyThreads == nThreads) {
+            std::chrono::duration<double> busySeconds = allBusy - start;
+            std::cerr << "all threads busy after " << busySeconds.count() << "s" << std::endl;
+        } else {
+            std::cerr << busyThreads << " of " << nThreads << " threads got work" << std::endl;
+        }
+        std::cerr << "nodes expanded: " << expanded << ", pruned: " << pruned << std::endl;
+        std::cerr << "heap chunks: " << pool_chunks() << std::endl;
+    }
+}
+
+int usage(const char *name) {
+    std::cout << "Usage: " << name << " [-v] [-s dfs|best|hybrid] [-d depth] [-b pair|onetree] [-r first|nearest|strong|fewest] [-i tour file] [-e auto|bnb|dp] [-k paths] <tsp file> <n threads=1>" << std::endl;
+    std::cout << "  -v  print statistics on stderr" << std::endl;
+    std::cout << "  -s  search strategy: depth first (default, least memory)," << std::endl;
+    std::cout << "      best first (fewest nodes), or best first down to depth then depth first" << std::endl;
+    std::cout << "  -d  depth threshold of the hybrid strategy (default 8)" << std::endl;
+    std::cout << "  -b  lower bound: two cheapest edges per node (default)," << std::endl;
+    std::cout << "      or Held-Karp 1-tree (slower per node, far fewer nodes)" << std::endl;
+    std::cout << "  -r  branching edge: first undecided, nearest neighbour of the first" << std::endl;
+    std::cout << "      undecided node (default), largest bound increase when excluded," << std::endl;
+    std::cout << "      or nearest neighbour of the node with the fewest undecided edges" << std::endl;
+    std::cout << "  -i  initial tour in the TSPLIB format (default: nearest neighbour)," << std::endl;
+    std::cout << "      improved by 2-opt and Or-opt before the search" << std::endl;
+    std::cout << "  -k  open paths per thread expanded breadth first before the search starts (default 4)" << std::endl;
+    std::cout << "  -e  exact solver: branch and bound (default), Held-Karp dynamic programming," << std::endl;
+    std::cout << "      or dynamic programming when quick and its table fits in memory" << std::endl;
+    return 1;
 }
 
 int main(int argc, char* argv[]) {
+    const char *name = argv[0];
     Matrix *matrix;
     int nThreads = 1;
-    // Create and set status
-    Status* statusTemp = new Status();
-    statusTemp->keepRunning = true;
-    for (int i = 0; i < 300; i++) {
-        statusTemp->threadStatus[i] = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:d:b:r:i:e:k:v")) != -1) {
+        switch (opt) {
+        case 's':
+            if (!strcmp(optarg, "dfs")) {
+                config.strategy = DEPTH_FIRST;
+            } else if (!strcmp(optarg, "best")) {
+                config.strategy = BEST_FIRST;
+            } else if (!strcmp(optarg, "hybrid")) {
+                config.strategy = HYBRID;
+            } else {
+                return usage(name);
+            }
+            break;
+        case 'd':
+            config.depth = std::stoi(optarg);
+            break;
+        case 'b':
+            if (!strcmp(optarg, "pair")) {
+                config.bound = PAIR;
+            } else if (!strcmp(optarg, "onetree")) {
+                config.bound = ONE_TREE;
+            } else {
+                return usage(name);
+            }
+            break;
+        case 'r':
+            if (!strcmp(optarg, "first")) {
+                config.branching = FIRST;
+            } else if (!strcmp(optarg, "nearest")) {
+                config.branching = NEAREST;
+            } else if (!strcmp(optarg, "strong")) {
+                config.branching = STRONG;
+            } else if (!strcmp(optarg, "fewest")) {
+                config.branching = FEWEST;
+            } else {
+                return usage(name);
+            }
+            break;
+        case 'i':
+            config.tourFile = optarg;
+            break;
+        case 'e':
+            if (!strcmp(optarg, "auto")) {
+                config.engine = AUTO;
+            } else if (!strcmp(optarg, "bnb")) {
+                config.engine = BRANCH_AND_BOUND;
+            } else if (!strcmp(optarg, "dp")) {
+                config.engine = DYNAMIC;
+            } else {
+                return usage(name);
+            }
+            break;
+        case 'k':
+            config.frontier = std::stoi(optarg);
+            if (config.frontier < 0) {
+                return usage(name);
+            }
+            break;
+        case 'v':
+            config.verbose = true;
+            break;
+        default:
+            return usage(name);
+        }
     }
-    runningStatus.set(statusTemp);
+    argc -= optind - 1;
+    argv += optind - 1;
 
     if (argc == 2) {
         std::string tspFile(argv[1]);
@@ -160,7 +385,7 @@ int main(int argc, char* argv[]) {
 
         for (int i = 0; i < 5; i++) {
             for (int j = 0; j < 5; j++) {
-                matrix->sdistance(i, j) = defaultMatrix[i][j];
+                matrix->set_distance(i, j, defaultMatrix[i][j]);
             }
         }
     } else if (argc == 3) {
@@ -168,7 +393,17 @@ int main(int argc, char* argv[]) {
         matrix = TSPFile::matrix(tspFile);
         nThreads = std::stoi(argv[2]);
     } else {
-        std::cout << "Usage: " << argv[0] << " <tsp file> <n threads=1>" << std::endl;
+        return usage(name);
+    }
+
+    if (matrix->order() > EdgeMatrix::MAX_ORDER) {
+        std::cerr << "At most " << EdgeMatrix::MAX_ORDER << " cities are supported" << std::endl;
+        return 1;
+    }
+
+    // The edges of the search are undirected, a tour costs the same both ways
+    if (!Heuristic::symmetric(matrix->order(), [matrix](int i, int j) { return matrix->distance(i, j); })) {
+        std::cerr << "Asymmetric distances are not supported, tspdp solves them" << std::endl;
         return 1;
     }
 
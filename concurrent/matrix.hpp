@@ -1,22 +1,57 @@
+#include <algorithm>
 #include <iostream>
+#include <memory>
+#include <vector>
+#include "../common/distances.hpp"
+#include "../common/instance_cache.hpp"
+#include "../common/tsplib.hpp"
 
 #ifndef MATRIX_HPP
 #define MATRIX_HPP
 
 class Matrix {
 public:
-    Matrix(int order) : _order(order) {
-        _distanceMatrix = new int*[order];
-        for (int i = 0; i < order; i++) {
-            _distanceMatrix[i] = new int[order];
-        }
+    /**
+     * @param maxDistance An upper bound of the distances, if known, to size the entries once.
+    */
+    Matrix(int order, int maxDistance = 0) : _order(order), _distances(order, maxDistance), _neighbours(nullptr) {
+    }
+
+    /**
+     * Use the tables of a cache file in place. The matrix is then read-only,
+     * its neighbours already sorted.
+    */
+    explicit Matrix(std::shared_ptr<InstanceCache> cache)
+        : _order(cache->order()), _distances(cache->order(), cache->stride(), cache->narrow(), cache->distances()),
+          _neighbours(const_cast<int *>(cache->neighbours())), _cache(cache) {
     }
 
-    int distance(int i, int j) const { return _distanceMatrix[i][j]; }
-    int& sdistance(int i, int j) { return _distanceMatrix[i][j]; }
+    int distance(int i, int j) const { return _distances.distance(i, j); }
+    void set_distance(int i, int j, int distance) { _distances.set(i, j, distance); }
 
     int order() const { return _order; }
-    int **matrix() const { return _distanceMatrix; }
+    const Distances &distances() const { return _distances; }
+
+    /**
+     * Get the other nodes sorted by increasing distance from node i.
+     * The list has order - 1 entries and is only valid after update_neighbours().
+    */
+    const int *neighbours(int i) const { return _neighbours + (size_t) i * _order; }
+
+    /**
+     * Sort the neighbours of every node, once all the distances are set.
+     * Ties are broken by node number. The lists take order^2 entries, so
+     * they are only built by the engines that use them.
+    */
+    void update_neighbours() {
+        if (_cache) {
+            return;
+        }
+        if (!_neighbours) {
+            _neighbours = new int[(size_t) _order * _order];
+        }
+        TSPLib::parallel_rows(_order, [this](int i) { update_neighbours(i); });
+    }
 
     void display() {
         std::cout << "\t";
@@ -32,12 +67,30 @@ public:
             }
             std::cout << std::endl;
         }
-        
     }
 
 private:
+    // Sorts the neighbours of node i only; distinct rows can be sorted in parallel
+    void update_neighbours(int i) {
+        // Sort (distance, node) pairs packed in one integer each
+        std::vector<uint64_t> keys;
+        keys.reserve(_order);
+        for (int j = 0; j < _order; j++) {
+            if (j != i) {
+                keys.push_back((uint64_t) (distance(i, j) + 2147483648LL) << 32 | j);
+            }
+        }
+        std::sort(keys.begin(), keys.end());
+        int *list = _neighbours + (size_t) i * _order;
+        for (size_t k = 0; k < keys.size(); k++) {
+            list[k] = (int) (keys[k] & 0xffffffff);
+        }
+    }
+
     int _order;
-    int **_distanceMatrix;
+    Distances _distances;
+    int *_neighbours;   // row i: the other nodes by increasing distance from i
+    std::shared_ptr<InstanceCache> _cache;  // holds the mapping the tables point into, if any
 };
 
 #endif // MATRIX_HPP
\ No newline at end of file
@@ -0,0 +1,198 @@
+#include <cmath>
+#include <limits>
+#include "matrix.hpp"
+#include "edge_matrix.hpp"
+
+#ifndef ONETREE_HPP
+#define ONETREE_HPP
+
+/**
+ * Held-Karp lower bound.
+ *
+ * A 1-tree is a spanning tree of the nodes 1..n-1 plus two edges at node 0.
+ * Every tour is a 1-tree, so the cheapest 1-tree is a lower bound. With node
+ * penalties pi, the weight of the edge (i, j) becomes d(i, j) + pi[i] + pi[j]:
+ * every tour pays 2 * sum(pi) more, while the cheapest 1-tree changes shape.
+ * The bound is the cheapest 1-tree minus 2 * sum(pi), and the penalties are
+ * improved by subgradient steps, raising pi on nodes of degree above 2 and
+ * lowering it on the leaves.
+ *
+ * Included edges are forced into the 1-tree, excluded edges are never used.
+ * The penalties are kept from one call to the next, so a child path starts
+ * from the penalties of its parent.
+*/
+class OneTree {
+public:
+    static const int ROOT_ITERATIONS = 100;
+    static const int ITERATIONS = 15;
+
+    /**
+     * Compute the Held-Karp bound of a subproblem.
+     * @param matrix The distance matrix.
+     * @param edges The edge states of the subproblem.
+     * @param penalties The node penalties, updated to the best ones found.
+     * @param upper The cost of the best known tour: stop once the bound reaches it.
+     * @param iterations The maximum number of subgradient steps.
+     * @return the lower bound, or INT_MAX if no 1-tree respects the edge states.
+    */
+    static int bound(const Matrix *matrix, const EdgeMatrix &edges, float *penalties, int upper, int iterations)
+    {
+        int order = edges.order();
+        float bestPenalties[EdgeMatrix::MAX_ORDER];
+        int degree[EdgeMatrix::MAX_ORDER];
+        double best = -std::numeric_limits<double>::infinity();
+        double alpha = 2.0;
+        int stall = 0;
+
+        for (int i = 0; i < order; i++) {
+            bestPenalties[i] = penalties[i];
+        }
+
+        for (int iteration = 0; iteration < iterations; iteration++) {
+            double length = 0;
+            if (!build(matrix, edges, penalties, degree, length)) {
+                return std::numeric_limits<int>::max();
+            }
+
+            double sum = 0;
+            int norm = 0;
+            for (int i = 0; i < order; i++) {
+                sum += penalties[i];
+                norm += (degree[i] - 2) * (degree[i] - 2);
+            }
+            double value = length - 2 * sum;
+
+            if (value > best + EPSILON) {
+                best = value;
+                stall = 0;
+                for (int i = 0; i < order; i++) {
+                    bestPenalties[i] = penalties[i];
+                }
+            } else if (++stall == STALL) {
+                alpha /= 2;
+                stall = 0;
+            }
+
+            // Pruned, or the 1-tree is a tour: no better bound to find
+            if (std::ceil(best - EPSILON) >= upper || norm == 0) {
+                break;
+            }
+
+            double target = upper == std::numeric_limits<int>::max() ? 1.1 * value + 1 : upper;
+            double step = alpha * (target - value) / norm;
+            for (int i = 0; i < order; i++) {
+                penalties[i] += step * (degree[i] - 2);
+            }
+        }
+
+        for (int i = 0; i < order; i++) {
+            penalties[i] = bestPenalties[i];
+        }
+        return (int) std::ceil(best - EPSILON);
+    }
+
+private:
+    static const int STALL = 5;
+    static constexpr double EPSILON = 1e-6;
+    static constexpr double FORCED = -1e15;
+
+    /**
+     * Build the cheapest 1-tree for the given penalties (Prim on the nodes 1..n-1).
+     * @param degree Set to the degree of every node in the 1-tree.
+     * @param length Set to the penalized length of the 1-tree.
+     * @return false if the edge states leave no 1-tree.
+    */
+    static bool build(const Matrix *matrix, const EdgeMatrix &edges, const float *penalties,
+                      int *degree, double &length)
+    {
+        int order = edges.order();
+        double key[EdgeMatrix::MAX_ORDER];
+        int from[EdgeMatrix::MAX_ORDER];
+        RowMask outside = edges.all() & ~EdgeMatrix::bit(0) & ~EdgeMatrix::bit(1);
+
+        for (int i = 0; i < order; i++) {
+            degree[i] = 0;
+        }
+        length = 0;
+
+        // Spanning tree of the nodes 1..n-1, the included edges first
+        for (RowMask rest = outside; rest; rest &= rest - 1) {
+            int v = __builtin_ctzll(rest);
+            key[v] = weight(matrix, edges, penalties, 1, v);
+            from[v] = 1;
+        }
+        while (outside) {
+            int next = -1;
+            for (RowMask rest = outside; rest; rest &= rest - 1) {
+                int v = __builtin_ctzll(rest);
+                if (next < 0 || key[v] < key[next]) {
+                    next = v;
+                }
+            }
+            if (key[next] == std::numeric_limits<double>::infinity()) {
+                return false;
+            }
+
+            outside &= ~EdgeMatrix::bit(next);
+            length += penalized(matrix, penalties, from[next], next);
+            degree[next]++;
+            degree[from[next]]++;
+
+            for (RowMask rest = outside; rest; rest &= rest - 1) {
+                int v = __builtin_ctzll(rest);
+                double w = weight(matrix, edges, penalties, next, v);
+                if (w < key[v]) {
+                    key[v] = w;
+                    from[v] = next;
+                }
+            }
+        }
+
+        // Two edges at node 0, the included edges first
+        RowMask included = edges.included(0);
+        RowMask unused = edges.unused(0);
+        for (int k = 0; k < 2; k++) {
+            int next = -1;
+            if (included) {
+                next = __builtin_ctzll(included);
+                included &= included - 1;
+            } else {
+                for (RowMask rest = unused; rest; rest &= rest - 1) {
+                    int v = __builtin_ctzll(rest);
+                    if (next < 0 || penalized(matrix, penalties, 0, v) < penalized(matrix, penalties, 0, next)) {
+                        next = v;
+                    }
+                }
+                if (next < 0) {
+                    return false;
+                }
+                unused &= ~EdgeMatrix::bit(next);
+            }
+            length += penalized(matrix, penalties, 0, next);
+            degree[0]++;
+            degree[next]++;
+        }
+
+        return true;
+    }
+
+    static double penalized(const Matrix *matrix, const float *penalties, int i, int j)
+    {
+        return matrix->distance(i, j) + penalties[i] + penalties[j];
+    }
+
+    // Weight used to pick the tree edges: included edges before anything else
+    static double weight(const Matrix *matrix, const EdgeMatrix &edges, const float *penalties, int i, int j)
+    {
+        int state = edges.get(i, j);
+        if (state == 1) {
+            return FORCED + penalized(matrix, penalties, i, j);
+        }
+        if (state == -1) {
+            return std::numeric_limits<double>::infinity();
+        }
+        return penalized(matrix, penalties, i, j);
+    }
+};
+
+#endif // ONETREE_HPP
@@ -1,300 +1,318 @@
-#include <vector>
+#include <algorithm>
 #include <limits>
 #include "matrix.hpp"
+#include "edge_matrix.hpp"
+#include "onetree.hpp"
+#include "containers/pool.hpp"
+#include "../common/kernels.hpp"
 
 #ifndef PATH_HPP
 #define PATH_HPP
 
-/**
- * The edge matrix is a matrix that represents the state of the edges of a path.
- * If the edge matrix at position [i][j] is 1, then the edge (i, j) is in the path.
- * If the edge matrix at position [i][j] is 0, then the edge (i, j) is unused.
- * If the edge matrix at position [i][j] is -1, then the edge (i, j) is excluded from the path.
-*/
-typedef std::vector<std::vector<int>> EdgeMatrix;
-
-
 /**
  * The Path class represents a path in the graph.
  * It contains the edge matrix, the lower bound, the cost, and the status of the path.
  * The status of the path is either complete or not complete.
- * A path is complete if all the edges are used.
+ * A path is complete if its included edges form a tour visiting every node.
+ *
+ * A path is built incrementally: a child is a copy of its parent on which
+ * edges are included or excluded one at a time. Every change only touches
+ * the two nodes of the edge, so the degrees, the partial fragments and the
+ * lower bound are updated in O(n) instead of being recomputed from the
+ * whole edge matrix.
+ *
+ * The Held-Karp bound can optionally tighten the lower bound. Its node
+ * penalties are copied along with the path, so the bound of a child starts
+ * from where the bound of its parent stopped.
 */
 class Path {
 public:
-    Path(Matrix *matrix, EdgeMatrix edgeMatrix)
-        : _pMatrix(matrix), _edgeMatrix(edgeMatrix)
+    /**
+     * Create the root path, where every edge is unused.
+    */
+    explicit Path(Matrix *matrix)
+        : _pMatrix(matrix), _edgeMatrix(matrix->order())
+    {
+        reset();
+    }
+
+    /**
+     * Create a path from an arbitrary edge matrix.
+     * The edges are applied one by one on the root path.
+    */
+    Path(Matrix *matrix, const EdgeMatrix &edgeMatrix)
+        : _pMatrix(matrix), _edgeMatrix(matrix->order())
     {
-        _valid = is_valid();
-        if (_valid) {
-            _lowerBound = get_lower_bound();
-            _complete = is_complete();
-            if (_complete) {
-                _cost = get_cost();
-            } else {
-                _cost = std::numeric_limits<int>::max();
+        reset();
+        int order = _pMatrix->order();
+        for (int i = 0; i < order && _valid; i++) {
+            for (int j = i+1; j < order && _valid; j++) {
+                if (edgeMatrix.get(i, j) == 1) {
+                    include(i, j);
+                }
+            }
+        }
+        for (int i = 0; i < order && _valid; i++) {
+            for (int j = i+1; j < order && _valid; j++) {
+                if (edgeMatrix.get(i, j) == -1) {
+                    exclude(i, j);
+                }
             }
-        } else {
-            _lowerBound = std::numeric_limits<int>::max();
         }
     }
 
+    // Paths are recycled through per-thread free lists
+    static void *operator new(size_t) { return Pool<Path>::allocate(); }
+    static void operator delete(void *pointer) { Pool<Path>::release(pointer); }
+
     bool valid() const { return _valid; }
-    int lower_bound() const { return _lowerBound; }
-    int cost() const { return _cost; }
+    int lower_bound() const { return _valid ? std::max((_bound + 1) / 2, _heldKarp) : std::numeric_limits<int>::max(); }
+    int cost() const { return _complete ? _length : std::numeric_limits<int>::max(); }
     bool complete() const { return _complete; }
+    int depth() const { return _depth; }
+    int included_edges() const { return _nEdges; }
 
-    EdgeMatrix edge_matrix() const { return _edgeMatrix; }
+    /**
+     * Get the other end of the fragment ending at node i.
+     * @return the other end (i itself for a node without edges), or -1 if i is inside a fragment.
+    */
+    int fragment_end(int i) const { return _ends[i]; }
 
-    void display() {
-        /*std::cout << "Edge matrix:" << std::endl;
-        for (int i = 0; i < _pMatrix->order(); i++) {
-            for (int j = 0; j < _pMatrix->order(); j++) {
-                std::cout << _edgeMatrix[i][j] << "\t";
-            }
-            std::cout << std::endl;
-        }
-        std::cout << "Valid: " << (_valid ? "Yes" : "No") << std::endl;
-        std::cout << "Lower bound: " << _lowerBound << std::endl;
-        std::cout << "Complete: " << (_complete ? "Yes" : "No") << std::endl;
-        std::cout << "Cost: " << _cost << std::endl;*/
+    const EdgeMatrix &edge_matrix() const { return _edgeMatrix; }
 
+    /**
+     * Get the number of included edges of node i.
+    */
+    int degree(int i) const { return __builtin_popcountll(_edgeMatrix.included(i)); }
 
-        if (_valid && _complete) {
-            int prev = 0;
-            int curr = 0;
-            int next = 0;
+    /**
+     * Mark the path as a child of its former self, one level deeper in the search tree.
+    */
+    void descend() { _depth++; }
 
-            //std::cout << "This path is:" << std::endl;
-            std::cout << "[" << _cost << ": " << curr;
-            for (int i = 0; i < _pMatrix->order(); i++) {
-                next = get_next_node(prev, curr);
-                prev = curr;
-                curr = next;
-                std::cout << " -> " << curr;
-            }
-            std::cout << "]" << std::endl;
+    /**
+     * Tighten the lower bound with the Held-Karp 1-tree bound.
+     * The bound of the parent stays valid for the child, so it never decreases.
+     * @param upper The cost of the best known tour.
+     * @param iterations The maximum number of subgradient steps.
+     * @return true if the path is still valid, false otherwise.
+    */
+    bool tighten(int upper, int iterations = OneTree::ITERATIONS)
+    {
+        if (!_valid || _complete) {
+            return _valid;
         }
+        int bound = OneTree::bound(_pMatrix, _edgeMatrix, _penalties, upper, iterations);
+        if (bound == std::numeric_limits<int>::max()) {
+            return invalidate();
+        }
+        _heldKarp = std::max(_heldKarp, bound);
+        return true;
     }
 
-
-private:
     /**
-     * Check if the edge matrix is valid.
-     * The edge matrix is valid if it contains only 0, 1, and -1.
-     * and if there is maximum 2 1s per row and per column.
-     * @return true if the edge matrix is valid, false otherwise.
+     * Include the edge (i, j) in the path.
+     * The path becomes invalid if i or j already has two edges,
+     * if the edge was excluded, or if it closes a cycle that does
+     * not visit every node.
+     * @return true if the path is still valid, false otherwise.
     */
-    bool is_valid()
+    bool include(int i, int j)
     {
-        int order = _pMatrix->order();
-
-        // Check if the edge matrix contains only 0, 1, and -1.
-        for (int i = 0; i < order; i++) {
-            for (int j = 0; j < order; j++) {
-                if (_edgeMatrix[i][j] != 0 && _edgeMatrix[i][j] != 1 && _edgeMatrix[i][j] != -1) {
-                    return false;
-                }
-            }
+        if (!_valid) {
+            return false;
         }
-
-        // Check if there is maximum 2 1s per row.
-        for (int i = 0; i < order; i++) {
-            int count = 0;
-            for (int j = 0; j < order; j++) {
-                if (_edgeMatrix[i][j] == 1) {
-                    count++;
-                }
-            }
-            if (count > 2) {
-                return false;
-            }
+        int state = _edgeMatrix.get(i, j);
+        if (state != 0) {
+            return state == 1 || invalidate();
         }
-
-        // Check if there is maximum 2 1s per column.
-        for (int j = 0; j < order; j++) {
-            int count = 0;
-            for (int i = 0; i < order; i++) {
-                if (_edgeMatrix[i][j] == 1) {
-                    count++;
-                }
-            }
-            if (count > 2) {
-                return false;
-            }
+        if (degree(i) == 2 || degree(j) == 2) {
+            return invalidate();
         }
 
-        // Check if there is at least 2 1s or 0s per row.
-        for (int i = 0; i < order; i++) {
-            int count = 0;
-            for (int j = 0; j < order; j++) {
-                if (_edgeMatrix[i][j] == 1 || (_edgeMatrix[i][j] == 0 && i != j)) {
-                    count++;
-                }
-            }
-            if (count < 2) {
-                return false;
-            }
+        // i and j are the ends of their fragments, a and b the other ends.
+        int a = _ends[i];
+        int b = _ends[j];
+        bool closing = (a == j);
+        if (closing && _nEdges + 1 != _pMatrix->order()) {
+            return invalidate();
         }
 
-        // Check if there is at least 2 1s or 0s per column.
-        for (int j = 0; j < order; j++) {
-            int count = 0;
-            for (int i = 0; i < order; i++) {
-                if (_edgeMatrix[i][j] == 1 || (_edgeMatrix[i][j] == 0 && i != j)) {
-                    count++;
-                }
+        int before = row_bound(i) + row_bound(j);
+        _edgeMatrix.set(i, j, 1);
+        _length += _pMatrix->distance(i, j);
+        _nEdges++;
+
+        if (closing) {
+            _ends[i] = _ends[j] = -1;
+            _complete = true;
+        } else {
+            _ends[a] = b;
+            _ends[b] = a;
+            if (a != i) {
+                _ends[i] = -1;
             }
-            if (count < 2) {
-                return false;
+            if (b != j) {
+                _ends[j] = -1;
             }
         }
 
-        // Check that there is no unwanted cycle.
-        int prev = 0;
-        int curr = 0;
-        int next = 0;
-        _nNodes = 0;
-        
-        while (true) {
-            next = get_next_node(prev, curr);
-            _nNodes++;
-            if (next == -1 || next == 0) {
-                break;
-            }
-            prev = curr;
-            curr = next;
-        }
+        return update_bound(i, j, before);
+    }
 
-        if (next == 0 && _nNodes != order) {
+    /**
+     * Exclude the edge (i, j) from the path.
+     * The path becomes invalid if the edge was included, or if i or j
+     * can no longer have two edges.
+     * @return true if the path is still valid, false otherwise.
+    */
+    bool exclude(int i, int j)
+    {
+        if (!_valid) {
             return false;
         }
+        int state = _edgeMatrix.get(i, j);
+        if (state != 0) {
+            return state == -1 || invalidate();
+        }
 
-        return true;
+        int before = row_bound(i) + row_bound(j);
+        _edgeMatrix.set(i, j, -1);
+
+        return update_bound(i, j, before);
     }
 
     /**
-     * Compute the lower bound cost of the path.
-     * The lower bound cost of the path is the sum of the weights of the edges
-     * that are used in the path, plus the sum of the minimum weights of the edges
-     * that are not used in the path.
-     * @return the lower bound cost of the path.
+     * Get how much excluding the unused edge (i, j) would raise twice the
+     * lower bound, without changing the path.
+     * @return the increase, or INT_MAX if the exclusion makes the path invalid.
     */
-    int get_lower_bound()
+    int exclusion_gain(int i, int j) const
     {
-        int order = _pMatrix->order();
-        int lowerBound = 0;
-
-        int** inMatrix = _pMatrix->matrix();
-
-        int min = std::numeric_limits<int>::max();
-        int min2 = std::numeric_limits<int>::max();
-
-        bool set = false;
-
-        // Compute the sum of the minimum weights of the edges that are not used in the path.
-        for (int i = 0; i < order; i++) {
-            int positiveEdges = 0;
-
-            for (int j = 0; j < order; j++) {
-                if (positiveEdges == 2) {
-                    break;
-                }
+        int rowI = row_bound(i, EdgeMatrix::bit(j));
+        int rowJ = row_bound(j, EdgeMatrix::bit(i));
+        if (rowI < 0 || rowJ < 0) {
+            return std::numeric_limits<int>::max();
+        }
+        return rowI + rowJ - row_bound(i) - row_bound(j);
+    }
 
-                if (_edgeMatrix[i][j] == 1 && !set) {
-                    positiveEdges++;
-                    set = true;
-                    min = inMatrix[i][j];
-                } else if (_edgeMatrix[i][j] == 1 && set) {
-                    positiveEdges++;
-                    min2 = inMatrix[i][j];
-                } else if (inMatrix[i][j] <= min && inMatrix[i][j] != 0 && _edgeMatrix[i][j] != -1 && !set) {
-                    if (min < min2) {
-                        min2 = min;
-                    }
-                    min = inMatrix[i][j];
-                } else if (inMatrix[i][j] < min2 && inMatrix[i][j] != 0 && _edgeMatrix[i][j] != -1) {
-                    min2 = inMatrix[i][j];
-                }
+    void display() {
+        /*std::cout << "Edge matrix:" << std::endl;
+        for (int i = 0; i < _pMatrix->order(); i++) {
+            for (int j = 0; j < _pMatrix->order(); j++) {
+                std::cout << _edgeMatrix.get(i, j) << "\t";
             }
+            std::cout << std::endl;
+        }
+        std::cout << "Valid: " << (_valid ? "Yes" : "No") << std::endl;
+        std::cout << "Lower bound: " << lower_bound() << std::endl;
+        std::cout << "Complete: " << (_complete ? "Yes" : "No") << std::endl;
+        std::cout << "Cost: " << cost() << std::endl;*/
 
-            set = false;
 
-            if (min == std::numeric_limits<int>::max() && min2 == std::numeric_limits<int>::max()) {
-                return 0;
-            }
+        if (_valid && _complete) {
+            int prev = 0;
+            int curr = 0;
+            int next = 0;
 
-            lowerBound += min + min2;
-            min = std::numeric_limits<int>::max();
-            min2 = std::numeric_limits<int>::max();
+            //std::cout << "This path is:" << std::endl;
+            std::cout << "[" << cost() << ": " << curr;
+            for (int i = 0; i < _pMatrix->order(); i++) {
+                next = get_next_node(prev, curr);
+                prev = curr;
+                curr = next;
+                std::cout << " -> " << curr;
+            }
+            std::cout << "]" << std::endl;
         }
-
-        lowerBound /= 2;
-
-        return lowerBound;
     }
 
+
+private:
     /**
-     * Compute the cost of the path.
-     * The cost of the path is the sum of the weights of the edges.
-     * @return the cost of the path.
+     * Reset the path to the root: no edge decided, every node
+     * being a fragment on its own.
     */
-    int get_cost()
+    void reset()
     {
         int order = _pMatrix->order();
-        int cost = 0;
-
+        _valid = true;
+        _complete = false;
+        _length = 0;
+        _nEdges = 0;
+        _depth = 0;
+        _bound = 0;
+        _heldKarp = 0;
         for (int i = 0; i < order; i++) {
-            for (int j = i+1; j < order; j++) {
-                if (_edgeMatrix[i][j] == 1) {
-                    cost += _pMatrix->matrix()[i][j];
-                }
+            _ends[i] = i;
+            _penalties[i] = 0;
+            int row = row_bound(i);
+            if (row < 0) {
+                invalidate();
+                return;
             }
+            _bound += row;
         }
+    }
 
-        return cost;
+    bool invalidate()
+    {
+        _valid = false;
+        _complete = false;
+        return false;
     }
 
     /**
-     * Check if the path is complete.
-     * A path is complete if all the edges are used
-     * and the path is circular (the last node is connected to the first node).
+     * Update the lower bound after the edge (i, j) has changed.
+     * @param before The contribution of the rows i and j before the change.
+     * @return true if the path is still valid, false otherwise.
     */
-    bool is_complete()
+    bool update_bound(int i, int j, int before)
     {
-        int order = _pMatrix->order();
-
-        // Check if all the edges are used.
-        for (int i = 0; i < order; i++) {
-            for (int j = 0; j < order; j++) {
-                if (_edgeMatrix[i][j] == 0 && i != j) {
-                    return false;
-                }
-            }
+        int rowI = row_bound(i);
+        int rowJ = row_bound(j);
+        if (rowI < 0 || rowJ < 0) {
+            return invalidate();
         }
+        _bound += rowI + rowJ - before;
+        return true;
+    }
 
-        // Check if the path is circular.
-        int prev = -1;
-        int node = 0;
-        int next = 0;
-        int count = 0;
-        bool circular = false;
-
-        while (count < order) {
-            next = get_next_node(prev, node);
-            if (next == -1) {
-                return false;
-            }
-            prev = node;
-            node = next;
-            count++;
-            if (node == 0 && count == order) {
-                circular = true;
-                break;
+    /**
+     * Compute the contribution of node i to the lower bound.
+     * A tour enters and leaves every node once, so the two edges of node i
+     * cost at least its included edges plus its cheapest unused edges.
+     * The lower bound of the path is half the sum over all the nodes.
+     * @param hidden Unused edges to leave out, as if they were excluded.
+     * @return the contribution of node i, or -1 if node i cannot have two edges.
+    */
+    int row_bound(int i, RowMask hidden = 0) const
+    {
+        const Distances &distances = _pMatrix->distances();
+        return distances.narrow() ? row_bound(distances.row16(i), i, hidden)
+                                  : row_bound(distances.row32(i), i, hidden);
+    }
+
+    template <typename T>
+    int row_bound(const T *row, int i, RowMask hidden) const
+    {
+        RowMask included = _edgeMatrix.included(i);
+        int missing = 2 - __builtin_popcountll(included);
+        int bound = Kernels::masked_sum(row, included);
+
+        if (missing > 0) {
+            int min;
+            int min2;
+            Kernels::two_min(row, _edgeMatrix.unused(i) & ~hidden, min, min2);
+            if (min == std::numeric_limits<int>::max() ||
+                (missing == 2 && min2 == std::numeric_limits<int>::max())) {
+                return -1;
             }
+            bound += missing == 2 ? min + min2 : min;
         }
 
-        return circular;
+        return bound;
     }
 
     /**
@@ -305,23 +323,22 @@ private:
     */
     int get_next_node(int prev, int node)
     {
-        int order = _pMatrix->order();
-        for (int i = 0; i < order; i++) {
-            if (_edgeMatrix[node][i] == 1 && i != prev) {
-                return i;
-            }
-        }
-        return -1;
+        RowMask next = _edgeMatrix.included(node) & ~EdgeMatrix::bit(prev);
+        return next ? __builtin_ctzll(next) : -1;
     }
 
     Matrix *_pMatrix;
     EdgeMatrix _edgeMatrix;
 
     bool _valid;
-    int _lowerBound;
-    int _cost;
     bool _complete;
-    int _nNodes;
+    int _bound;     // sum of the contributions of every node, twice the lower bound
+    int _length;    // sum of the weights of the included edges
+    int _nEdges;    // number of included edges
+    int _depth;     // number of branchings from the root
+    int _heldKarp;  // best Held-Karp bound of the path or of its ancestors
+    float _penalties[EdgeMatrix::MAX_ORDER];    // node penalties of the Held-Karp bound
+    signed char _ends[EdgeMatrix::MAX_ORDER];   // other end of the fragment, -1 inside a fragment
 };
 
-#endif // PATH_HPP
\ No newline at end of file
+#endif // PATH_HPP
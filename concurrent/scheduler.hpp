@@ -0,0 +1,203 @@
+#include <memory>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "path.hpp"
+#include "containers/deque.hpp"
+#include "containers/multiqueue.hpp"
+
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+/**
+ * Order in which the open paths are explored.
+ * DEPTH_FIRST keeps the fewest open paths, BEST_FIRST expands the fewest
+ * paths, HYBRID is best first above a depth threshold and depth first below.
+*/
+enum Strategy { DEPTH_FIRST, BEST_FIRST, HYBRID };
+
+/**
+ * The Scheduler distributes the open paths among the worker threads.
+ *
+ * Depth first: every worker owns a work-stealing deque, it pushes and pops
+ * its own paths in LIFO order, so it explores its subtree depth first.
+ * A worker running out of paths steals the oldest path of another worker,
+ * which is the shallowest and therefore the largest subtree.
+ *
+ * Best first: the paths are kept in a relaxed concurrent priority queue
+ * keyed on their lower bound, so the most promising path is expanded next.
+ *
+ * Hybrid: paths shallower than the depth threshold go to the priority queue,
+ * deeper paths go to the deque of the worker. A worker finishes its own
+ * subtree before taking the next most promising path from the queue.
+ *
+ * Termination: the scheduler counts the pending paths, pushed but not done yet.
+ * A worker without work backs off exponentially, then sleeps until a path is
+ * pushed. The search is over when the count drops to zero, which wakes everyone.
+*/
+class Scheduler {
+public:
+    Scheduler(int nThreads, Strategy strategy = DEPTH_FIRST, int depth = 0)
+        : _nThreads(nThreads), _strategy(strategy), _depth(depth),
+          _deques(new WorkStealingDeque<Path*>[nThreads]),
+          _queue(2 * nThreads),
+          _pending(0), _sleepers(0), _epoch(0)
+    {
+    }
+
+    int threads() const { return _nThreads; }
+
+    /**
+     * Push a path for worker tid.
+     * Must be called by worker tid, or before the workers are started.
+    */
+    void push(int tid, Path *path) {
+        _pending.fetch_add(1, std::memory_order_relaxed);
+        if (_strategy == BEST_FIRST || (_strategy == HYBRID && path->depth() < _depth)) {
+            _queue.push(path->lower_bound(), path);
+        } else {
+            _deques[tid].push(path);
+        }
+
+        // Pairs with the fence in park(): either the sleeper sees the path,
+        // or we see the sleeper.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_sleepers.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _epoch++;
+            _wakeup.notify_one();
+        }
+    }
+
+    /**
+     * Get the next path for worker tid, waiting for one if needed.
+     * Every path returned must be handed back with done() once processed.
+     * @return the path or nullptr if the search is over.
+    */
+    Path *next(int tid) {
+        for (int spins = 1; ; spins = spins < MAX_SPINS ? 2 * spins : spins) {
+            Path *path = pop(tid);
+            if (path != nullptr) {
+                return path;
+            }
+            if (finished()) {
+                return nullptr;
+            }
+            if (spins < MAX_SPINS) {
+                for (int i = 0; i < spins; i++) {
+                    pause();
+                }
+            } else {
+                path = park(tid);
+                if (path != nullptr) {
+                    return path;
+                }
+                spins = 1;
+            }
+        }
+    }
+
+    /**
+     * Signal that a path returned by next() has been processed,
+     * after its childs have been pushed.
+    */
+    void done() {
+        if (_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _epoch++;
+            _wakeup.notify_all();
+        }
+    }
+
+    bool finished() const {
+        return _pending.load(std::memory_order_acquire) == 0;
+    }
+
+private:
+    static const int MAX_SPINS = 1 << 10;
+
+    /**
+     * Get a path for worker tid: its own latest path if any, otherwise
+     * the most promising queued path, otherwise a path stolen from another worker.
+     * @return the path or nullptr if no path was found.
+    */
+    Path *pop(int tid) {
+        Path *path = nullptr;
+        if (_strategy != BEST_FIRST) {
+            path = _deques[tid].pop();
+        }
+        if (path == nullptr && _strategy != DEPTH_FIRST) {
+            path = _queue.pop();
+        }
+        if (path == nullptr && _strategy != BEST_FIRST) {
+            path = steal(tid);
+        }
+        return path;
+    }
+
+    /**
+     * Sleep until a path is pushed or the search is over.
+     * @return a path found while going to sleep, nullptr otherwise.
+    */
+    Path *park(int tid) {
+        uint64_t epoch = _epoch.load(std::memory_order_acquire);
+        _sleepers.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        Path *path = pop(tid);
+        if (path == nullptr) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wakeup.wait(lock, [&] { return _epoch.load(std::memory_order_relaxed) != epoch || finished(); });
+        }
+
+        _sleepers.fetch_sub(1, std::memory_order_relaxed);
+        return path;
+    }
+
+    static void pause() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+    /**
+     * Try every other worker once, starting from a random victim.
+    */
+    Path *steal(int tid) {
+        static thread_local uint32_t seed = 2463534242u + tid;
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+
+        int start = seed % _nThreads;
+        for (int i = 0; i < _nThreads; i++) {
+            int victim = (start + i) % _nThreads;
+            if (victim == tid) {
+                continue;
+            }
+            Path *path = _deques[victim].steal();
+            if (path != nullptr) {
+                return path;
+            }
+        }
+        return nullptr;
+    }
+
+    int _nThreads;
+    Strategy _strategy;
+    int _depth;
+    std::unique_ptr<WorkStealingDeque<Path*>[]> _deques;
+    MultiQueue<Path*> _queue;
+
+    alignas(64) std::atomic<long> _pending;     // paths pushed and not done yet
+    alignas(64) std::atomic<int> _sleepers;     // workers in park()
+    std::atomic<uint64_t> _epoch;               // bumped on every wake up
+    std::mutex _mutex;
+    std::condition_variable _wakeup;
+};
+
+#endif // SCHEDULER_HPP
@@ -1,15 +1,18 @@
 //
 //  tsp.cpp
-//  
+//
 //  Copyright (c) 2022 Marcelo Pasin. All rights reserved.
 //
 
 #include "../sequential/graph.hpp"
 #include "../sequential/path.hpp"
 #include "../sequential/tspfile.hpp"
+#include "../common/heuristic.hpp"
 #include "containers/containers.hpp"
-#include "containers/atomic.hpp"
+#include <atomic>
 #include <chrono>
+#include <thread>
+#include <vector>
 
 
 enum Verbosity {
@@ -21,14 +24,22 @@ enum Verbosity {
     VER_COUNTERS = 16,
 };
 
+// Work items per thread the top of the tree is split into, at least
+static const int ITEMS_PER_THREAD = 32;
+
 static struct {
+    Graph* graph;
     Verbosity verbose;
     struct {
-        int* bound; // # of bound operations per level
+        std::atomic<int> verified;  // # of paths checked
+        std::atomic<int> found;     // # of times a shorter path was found
+        std::atomic<int>* bound;    // # of bound operations per level
     } counter;
     int size;
     int total;      // number of paths to check
     int* fact;
+    std::vector<std::vector<int>> items;    // path prefixes, searched by the threads
+    std::atomic<int> next;                  // next item to search
 } global;
 
 Container container;
@@ -53,20 +64,21 @@ static void branch_and_bound(Path* current)
         // this is a leaf
         current->add(0);
         if (global.verbose & VER_COUNTERS)
-            container.set_verified_path(new int(container.get_verified_path() + 1));
-        if (current->distance() < container.get_path().distance()) {
+            global.counter.verified ++;
+        if (container.offer_path(current)) {
             if (global.verbose & VER_SHORTER)
                 std::cout << "shorter: " << current << '\n';
-            container.set_path(current);
             if (global.verbose & VER_COUNTERS)
-                container.set_verified_path(new int(container.get_verified_path() + 1));
+                global.counter.found ++;
         }
         current->pop();
     } else {
         // not yet a leaf
-        if (current->distance() < container.get_path().distance()) {
-            // continue branching
-            for (int i=1; i<current->max(); i++) {
+        if (current->bound() < container.get_distance()) {
+            // continue branching, nearest cities first
+            int last = current->at(current->size() - 1);
+            for (int k=0; k<current->max()-1; k++) {
+                int i = global.graph->neighbour(last, k);
                 if (!current->contains(i)) {
                     current->add(i);
                     branch_and_bound(current);
@@ -74,7 +86,7 @@ static void branch_and_bound(Path* current)
                 }
             }
         } else {
-            // current already >= shortest known so far, bound
+            // no tour starting with current can be shorter, bound
             if (global.verbose & VER_BOUND )
                 std::cout << "bound " << current << '\n';
             if (global.verbose & VER_COUNTERS)
@@ -83,14 +95,63 @@ static void branch_and_bound(Path* current)
     }
 }
 
+// Split the top levels of the tree, one level at a time, until every
+// thread has enough items to balance the load. Prefixes are kept in
+// nearest-first order, so the first items searched are the promising ones.
+static void split(int nThreads)
+{
+    Graph* g = global.graph;
+    Path* current = new Path(g);
+    global.items.assign(1, std::vector<int>(1, 0));
+    while ((int) global.items.size() < ITEMS_PER_THREAD * nThreads && (int) global.items[0].size() < g->size() - 1) {
+        std::vector<std::vector<int>> items;
+        for (const std::vector<int>& item : global.items) {
+            current->clear();
+            for (int node : item)
+                current->add(node);
+            for (int k=0; k<g->size()-1; k++) {
+                int i = g->neighbour(item.back(), k);
+                if (current->contains(i))
+                    continue;
+                current->add(i);
+                if (current->bound() < container.get_distance()) {
+                    items.push_back(item);
+                    items.back().push_back(i);
+                } else if (global.verbose & VER_COUNTERS) {
+                    global.counter.bound[current->size()] ++;
+                }
+                current->pop();
+            }
+        }
+        global.items.swap(items);
+        if (global.items.empty())
+            break;
+    }
+    delete current;
+}
+
+// Search items until there are none left, on a path of the thread's own
+static void work()
+{
+    Path* current = new Path(global.graph);
+    for (int k = global.next ++; k < (int) global.items.size(); k = global.next ++) {
+        current->clear();
+        for (int node : global.items[k])
+            current->add(node);
+        branch_and_bound(current);
+    }
+    delete current;
+}
+
 
 void reset_counters(int size)
 {
     global.size = size;
-    container.set_verified_path(new int(0));
-    container.set_path(new Path(nullptr));
+    global.counter.verified = 0;
+    global.counter.found = 0;
+    global.counter.bound = new std::atomic<int>[global.size + 1]();
+    global.fact = new int[global.size + 1];
     for (int i=0; i<global.size; i++) {
-        global.counter.bound[i] = 0;
         if (i) {
             int pos = global.size - i;
             global.fact[pos] = (i-1) ? (i * global.fact[pos+1]) : 1;
@@ -102,8 +163,8 @@ void reset_counters(int size)
 void print_counters()
 {
     std::cout << "total: " << global.total << '\n';
-    std::cout << "verified: " << container.get_verified_path() << '\n';
-    std::cout << "found shorter: " << container.get_verified_path() << '\n';
+    std::cout << "verified: " << global.counter.verified << '\n';
+    std::cout << "found shorter: " << global.counter.found << '\n';
     std::cout << "bound (per level):";
     for (int i=0; i<global.size; i++)
         std::cout << ' ' << global.counter.bound[i];
@@ -115,7 +176,13 @@ void print_counters()
         equiv += e;
     }
     std::cout << "\nbound equivalent (total): " << equiv << '\n';
-    std::cout << "check: total " << (global.total==(container.get_verified_path() + equiv) ? "==" : "!=") << " verified + total bound equivalent\n";
+    std::cout << "check: total " << (global.total==(global.counter.verified + equiv) ? "==" : "!=") << " verified + total bound equivalent\n";
+}
+
+static int usage(const char* name)
+{
+    fprintf(stderr, "usage: %s [-v#] filename [threads]\n", name);
+    return 1;
 }
 
 int main(int argc, char* argv[])
@@ -124,39 +191,49 @@ int main(int argc, char* argv[])
     std::chrono::steady_clock::time_point end;
 
     char* fname = 0;
-    if (argc == 2) {
-        fname = argv[1];
-        global.verbose = VER_NONE;
-    } else {
-        if (argc == 3 && argv[1][0] == '-' && argv[1][1] == 'v') {
-            global.verbose = (Verbosity) (argv[1][2] ? atoi(argv[1]+2) : 1);
-            fname = argv[2];
-        } else {
-            fprintf(stderr, "usage: %s [-v#] filename\n", argv[0]);
-            exit(1);
-        }
+    int nThreads = 1;
+    int arg = 1;
+    global.verbose = VER_NONE;
+    if (arg < argc && argv[arg][0] == '-' && argv[arg][1] == 'v') {
+        global.verbose = (Verbosity) (argv[arg][2] ? atoi(argv[arg]+2) : 1);
+        arg ++;
     }
+    if (arg == argc || argc - arg > 2)
+        return usage(argv[0]);
+    fname = argv[arg];
+    if (arg + 1 < argc)
+        nThreads = atoi(argv[arg + 1]);
+    if (nThreads < 1)
+        return usage(argv[0]);
 
     Graph* g = TSPFile::graph(fname);
+    g->update_neighbours();
+    global.graph = g;
     if (global.verbose & VER_GRAPH)
         std::cout << COLOR.BLUE << g << COLOR.ORIGINAL;
 
     if (global.verbose & VER_COUNTERS)
         reset_counters(g->size());
 
-    container.set_path(new Path(g));
-    for (int i=0; i<g->size(); i++) {
-        container.get_path().add(i);
-    }
-    container.get_path().add(0);
+    // initial shortest path: heuristic tour
+    auto distance = [g](int i, int j) { return g->distance(i, j); };
+    Path* shortest = new Path(g);
+    for (int node : Heuristic::tour(g->size(), distance))
+        shortest->add(node);
+    shortest->add(0);
+    container.set_path(shortest);
 
     begin = std::chrono::steady_clock::now();
-    Path* current = new Path(g);
-    current->add(0);
-    branch_and_bound(current);
+    split(nThreads);
+    std::vector<std::thread> threads;
+    for (int t=1; t<nThreads; t++)
+        threads.emplace_back(work);
+    work();
+    for (std::thread& thread : threads)
+        thread.join();
     end = std::chrono::steady_clock::now();
 
-    container.print_path();
+    std::cout << COLOR.RED << "shortest " << container.get_path() << COLOR.ORIGINAL << '\n';
 
     if (global.verbose & VER_COUNTERS)
         print_counters();
@@ -10,41 +10,127 @@
 #include <iostream>
 #include <iomanip>
 #include <stdio.h>
+#include <algorithm>
+#include <climits>
+#include <memory>
+#include <vector>
+#include "../common/distances.hpp"
+#include "../common/instance_cache.hpp"
+#include "../common/tsplib.hpp"
 
 class Graph {
 private: 
 	int _max_size;
 	int _size;
-	int *_distances;
+	Distances _distances;
 	int *_x;
 	int *_y;
+	int *_min1;	// cheapest edge of each node, either way
+	int *_min2;	// second cheapest edge of each node, either way
+	int *_neighbours;	// row i: the other nodes by increasing distance from i
+	std::shared_ptr<InstanceCache> _cache;	// holds the mapping the tables point into, if any
 
 public:
-	Graph(int size) {
+	// max_distance: an upper bound of the distances, if known, to size the entries once
+	Graph(int size, int max_distance = 0) : _distances(size, max_distance) {
 		_max_size = size;
-		_distances = new int[size * size];
-		for (int i=0; i<size; i++)
-			for (int j=0; j<size; j++)
-				sdistance(i, j) = -1;
 		_x = new int[size];
 		_y = new int[size];
+		_min1 = new int[size]();
+		_min2 = new int[size]();
+		_neighbours = 0;
 		_size = 0;
 	}
 
+	// uses the tables of a cache file in place: the graph is complete and read-only
+	Graph(std::shared_ptr<InstanceCache> cache)
+		: _distances(cache->order(), cache->stride(), cache->narrow(), cache->distances()), _cache(cache) {
+		_max_size = _size = cache->order();
+		_x = new int[_size]();
+		_y = new int[_size]();
+		_min1 = new int[_size];
+		_min2 = new int[_size];
+		_neighbours = const_cast<int*>(cache->neighbours());
+		for (int i=0; i<_size; i++)
+			update_minimums(i);
+	}
+
 	~Graph()
 	{
 		delete _x;
 		delete _y;
-		delete _distances;
-		_x = _y = _distances = 0;
+		delete[] _min1;
+		delete[] _min2;
+		if (!_cache)
+			delete[] _neighbours;
+		_x = _y = _min1 = _min2 = _neighbours = 0;
 		_max_size = 0;
 	}
 
 	int size() const { return _size; }
-	int distance(int i, int j) const { return _distances[i + _max_size * j]; }
-	int& sdistance(int i, int j) { return _distances[i + _max_size * j]; }
+	int distance(int i, int j) const { return _distances.distance(i, j); }
+	void set_distance(int i, int j, int distance) { _distances.set(i, j, distance); }
+	const Distances& distances() const { return _distances; }
 	int add(int x, int y) { _x[_size] = x; _y[_size] = y; return _size ++; }
+	int min1(int i) const { return _min1[i]; }
+	int min2(int i) const { return _min2[i]; }
+
+	// other nodes by increasing distance from node i
+	int neighbour(int i, int k) const { return _neighbours[(size_t) i * _max_size + k]; }
+
+	// to be called once the distances are set, by the engines that use the
+	// neighbours: the lists take size^2 entries
+	void update_neighbours()
+	{
+		if (_cache)
+			return;
+		if (!_neighbours)
+			_neighbours = new int[(size_t) _max_size * _max_size];
+		TSPLib::parallel_rows(_size, [this](int i) { update_neighbours(i); });
+	}
 
+private:
+	// distinct rows can be sorted in parallel
+	void update_neighbours(int i)
+	{
+		// sort (distance, node) pairs packed in one integer each
+		std::vector<uint64_t> keys;
+		keys.reserve(_size);
+		for (int j=0; j<_size; j++)
+			if (j != i)
+				keys.push_back((uint64_t) (distance(i, j) + 2147483648LL) << 32 | j);
+		std::sort(keys.begin(), keys.end());
+		int* list = _neighbours + (size_t) i * _max_size;
+		int n = keys.size();
+		for (int k=0; k<n; k++)
+			list[k] = (int) (keys[k] & 0xffffffff);
+		update_minimums(i);
+	}
+
+	// a tour enters node i from one node and leaves it to another, so its two
+	// edges cost at least the two cheapest of min(d(i, j), d(j, i)) over the
+	// other nodes j, whether the distances are symmetric or not
+	void update_minimums(int i)
+	{
+		_min1[i] = _min2[i] = INT_MAX;
+		for (int j=0; j<_size; j++) {
+			if (j == i)
+				continue;
+			int d = std::min(distance(i, j), distance(j, i));
+			if (d < _min1[i]) {
+				_min2[i] = _min1[i];
+				_min1[i] = d;
+			} else if (d < _min2[i]) {
+				_min2[i] = d;
+			}
+		}
+		if (_min1[i] == INT_MAX)
+			_min1[i] = 0;
+		if (_min2[i] == INT_MAX)
+			_min2[i] = _min1[i];
+	}
+
+public:
 	void print(std::ostream& os) const
 	{
 		char fmt[100];
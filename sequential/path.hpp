@@ -5,6 +5,7 @@
 //
 
 #include <iostream>
+#include <cstdint>
 #include "graph.hpp"
 
 #ifndef _path_hpp
@@ -15,13 +16,20 @@ private:
 	int _size;
 	int _distance;
 	int* _nodes;
+	uint64_t* _visited;	// one bit per node, the bits past max() are always set
+	int _words;
+	int _remaining;	// sum of min1 + min2 over the nodes not in the path
 	Graph* _graph;
+
+	static int words(int max) { return (max + 63) / 64; }
 public:
 	~Path()
 	{
 		clear();
 		delete[] _nodes;
+		delete[] _visited;
 		_nodes = 0;
+		_visited = 0;
 		_graph = 0;
 	}
 
@@ -29,6 +37,8 @@ public:
 	{
 		_graph = graph;
 		_nodes = new int[max() + 1];
+		_words = words(max());
+		_visited = new uint64_t[_words];
 		_distance = 0;
 		clear();
 	}
@@ -37,7 +47,27 @@ public:
 	int size() const { return _size; }
 	bool leaf() const { return (_size == max()); }
 	int distance() const { return _distance; }
-	void clear() { _size = _distance = 0; }
+
+	// lower bound of every tour starting with this path: the distance plus
+	// half the cheapest edges still needed, two at each free node, one at
+	// each end of the path
+	int bound() const
+	{
+		if (_size > max())
+			return _distance;
+		int ends = _size ? _graph->min1(_nodes[0]) + _graph->min1(_nodes[_size - 1]) : 0;
+		return _distance + (_remaining + ends + 1) / 2;
+	}
+	void clear()
+	{
+		_size = _distance = _remaining = 0;
+		for (int i=0; i<max(); i++)
+			_remaining += _graph->min1(i) + _graph->min2(i);
+		for (int w=0; w<_words; w++)
+			_visited[w] = 0;
+		if (max() % 64)
+			_visited[_words - 1] = ~0ULL << (max() % 64);
+	}
 
 	void add(int node)
 	{
@@ -48,6 +78,10 @@ public:
 				_distance += distance;
 			}
 			_nodes[_size ++] = node;
+			if (!contains(node)) {
+				_visited[node / 64] |= 1ULL << (node % 64);
+				_remaining -= _graph->min1(node) + _graph->min2(node);
+			}
 		}
 	}
 
@@ -55,6 +89,11 @@ public:
 	{
 		if (_size) {
 			int last = _nodes[-- _size];
+			// the first node is added again to close the tour, it stays visited
+			if (!_size || _nodes[0] != last) {
+				_visited[last / 64] &= ~(1ULL << (last % 64));
+				_remaining += _graph->min1(last) + _graph->min2(last);
+			}
 			if (_size) {
 				int node = _nodes[_size - 1];
 				int distance = _graph->distance(node, last);
@@ -65,10 +104,7 @@ public:
 
 	bool contains(int node) const
 	{
-		for (int i=0; i<_size; i++)
-			if (_nodes[i] == node)
-				return true;
-		return false;
+		return _visited[node / 64] & (1ULL << (node % 64));
 	}
 
 	int at(int i) const 
@@ -80,13 +116,19 @@ public:
 	{
 		if (max() != o->max()) {
 			delete[] _nodes;
+			delete[] _visited;
 			_nodes = new int[o->max() + 1];
+			_words = o->_words;
+			_visited = new uint64_t[_words];
 		}
 		_graph = o->_graph;
 		_size = o->_size;
 		_distance = o->_distance;
+		_remaining = o->_remaining;
 		for (int i=0; i<_size; i++)
 			_nodes[i] = o->_nodes[i];
+		for (int w=0; w<_words; w++)
+			_visited[w] = o->_visited[w];
 	}
 
 	void print(std::ostream& os) const
@@ -7,7 +7,13 @@
 #include "graph.hpp"
 #include "path.hpp"
 #include "tspfile.hpp"
+#include "../common/heuristic.hpp"
+#include <atomic>
 #include <chrono>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 
 enum Verbosity {
@@ -20,7 +26,10 @@ enum Verbosity {
 };
 
 static struct {
+	Graph* graph;
 	Path* shortest;
+	std::atomic<int> best;	// distance of shortest, read by the bound test without locking
+	int cutoff;		// paths shorter than this branch into OpenMP tasks
 	Verbosity verbose;
 	struct {
 		int verified;	// # of paths checked
@@ -43,6 +52,15 @@ static const struct {
 };
 
 
+// counters are shared by the OpenMP tasks
+static inline void count(int& counter)
+{
+#ifdef _OPENMP
+	#pragma omp atomic
+#endif
+	counter ++;
+}
+
 static void branch_and_bound(Path* current)
 {
 	if (global.verbose & VER_ANALYSE)
@@ -52,32 +70,56 @@ static void branch_and_bound(Path* current)
 		// this is a leaf
 		current->add(0);
 		if (global.verbose & VER_COUNTERS)
-			global.counter.verified ++;
-		if (current->distance() < global.shortest->distance()) {
-			if (global.verbose & VER_SHORTER)
-				std::cout << "shorter: " << current << '\n';
-			global.shortest->copy(current);
-			if (global.verbose & VER_COUNTERS)
-				global.counter.found ++;
+			count(global.counter.verified);
+		if (current->distance() < global.best.load(std::memory_order_relaxed)) {
+			// checked again, another task may have found a shorter one meanwhile
+#ifdef _OPENMP
+			#pragma omp critical(shortest)
+#endif
+			if (current->distance() < global.shortest->distance()) {
+				if (global.verbose & VER_SHORTER)
+					std::cout << "shorter: " << current << '\n';
+				global.shortest->copy(current);
+				global.best.store(current->distance(), std::memory_order_relaxed);
+				if (global.verbose & VER_COUNTERS)
+					global.counter.found ++;
+			}
 		}
 		current->pop();
 	} else {
 		// not yet a leaf
-		if (current->distance() < global.shortest->distance()) {
+		if (current->bound() < global.best.load(std::memory_order_relaxed)) {
 			// continue branching
-			for (int i=1; i<current->max(); i++) {
+			// nearest cities first, to find short tours early
+			int last = current->at(current->size() - 1);
+			for (int k=0; k<current->max()-1; k++) {
+				int i = global.graph->neighbour(last, k);
 				if (!current->contains(i)) {
+#ifdef _OPENMP
+					// near the root, every child is a task on its own copy of the path
+					if (current->size() < global.cutoff) {
+						Path* child = new Path(global.graph);
+						child->copy(current);
+						child->add(i);
+						#pragma omp task firstprivate(child)
+						{
+							branch_and_bound(child);
+							delete child;
+						}
+						continue;
+					}
+#endif
 					current->add(i);
 					branch_and_bound(current);
 					current->pop();
 				}
 			}
 		} else {
-			// current already >= shortest known so far, bound
+			// no tour starting with current can be shorter, bound
 			if (global.verbose & VER_BOUND )
 				std::cout << "bound " << current << '\n';
 			if (global.verbose & VER_COUNTERS)
-				global.counter.bound[current->size()] ++;
+				count(global.counter.bound[current->size()]);
 		}
 	}
 }
@@ -125,35 +167,67 @@ int main(int argc, char* argv[])
 	std::chrono::steady_clock::time_point end;
 	
 	char* fname = 0;
-	if (argc == 2) {
-		fname = argv[1];
-		global.verbose = VER_NONE;
-	} else {
-		if (argc == 3 && argv[1][0] == '-' && argv[1][1] == 'v') {
-			global.verbose = (Verbosity) (argv[1][2] ? atoi(argv[1]+2) : 1);
-			fname = argv[2];
-		} else {
-			fprintf(stderr, "usage: %s [-v#] filename\n", argv[0]);
+	char* tour_file = 0;
+	int opt;
+	global.verbose = VER_NONE;
+	global.cutoff = 3;
+	while ((opt = getopt(argc, argv, "v::i:c:")) != -1) {
+		switch (opt) {
+		case 'v':
+			global.verbose = (Verbosity) (optarg ? atoi(optarg) : 1);
+			break;
+		case 'i':
+			tour_file = optarg;
+			break;
+		case 'c':
+			global.cutoff = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-v#] [-i tourfile] [-c cutoff] filename\n", argv[0]);
 			exit(1);
 		}
 	}
+	if (optind != argc - 1) {
+		fprintf(stderr, "usage: %s [-v#] [-i tourfile] [-c cutoff] filename\n", argv[0]);
+		exit(1);
+	}
+	fname = argv[optind];
 
 	Graph* g = TSPFile::graph(fname);
+	g->update_neighbours();
+	global.graph = g;
 	if (global.verbose & VER_GRAPH)
 		std::cout << COLOR.BLUE << g << COLOR.ORIGINAL;
 
 	if (global.verbose & VER_COUNTERS)
 		reset_counters(g->size());
 
+	// initial shortest path: heuristic tour, or the one given in tour_file,
+	// improved by the local search only if the distances are symmetric
+	auto distance = [g](int i, int j) { return g->distance(i, j); };
+	begin = std::chrono::steady_clock::now();
+	std::vector<int> tour = tour_file ? Heuristic::read_tour(tour_file, g->size())
+	                                  : Heuristic::nearest_neighbour(g->size(), distance);
+	if (Heuristic::symmetric(g->size(), distance))
+		Heuristic::improve(tour, distance);
+	end = std::chrono::steady_clock::now();
+
 	global.shortest = new Path(g);
-	for (int i=0; i<g->size(); i++) {
-		global.shortest->add(i);
+	for (int node : tour) {
+		global.shortest->add(node);
 	}
 	global.shortest->add(0);
+	global.best = global.shortest->distance();
+	std::cout << "heuristic " << global.shortest << " in " << std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() << "us\n";
 
 	begin = std::chrono::steady_clock::now();
 	Path* current = new Path(g);
 	current->add(0);
+#ifdef _OPENMP
+	// one thread walks the top of the tree, the team runs the tasks it creates
+	#pragma omp parallel
+	#pragma omp single
+#endif
 	branch_and_bound(current);
 	end = std::chrono::steady_clock::now();
 